@@ -0,0 +1,393 @@
+// Decoder microbenchmarks
+//
+// Measures decode and text rendering throughput over synthesized instruction
+// streams and optionally compares the results against a saved baseline:
+//
+//   riscv_decoder_bench [--json out.json] [--compare baseline.json] [--threshold percent]
+//
+// Each result is the median of several rounds, with its spread, the median
+// absolute deviation of the rounds in percent. With --compare the exit status
+// is 1 if any benchmark is slower than the baseline by more than the
+// threshold (20% by default), or by more than three times the combined
+// spread of both runs when that is larger. Regressed benchmarks are measured
+// again, up to twice, and only fail if they regress every time.
+
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <random>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "compressed.h"
+#include "decodeCache.h"
+#include "diagnostics.h"
+#include "disassembler.h"
+#include "formatter.h"
+
+namespace {
+struct Stream {
+	std::string name;
+	std::vector<uint8_t> bytes;
+	// Offsets of the instructions in a linear sweep of the stream
+	std::vector<size_t> offsets;
+	bool wordsOnly;
+};
+
+struct Result {
+	std::string name;
+	double nsPerInstr;
+	double instrPerSec;
+	// Median absolute deviation of the rounds, in percent of nsPerInstr
+	double spread;
+};
+
+struct Baseline {
+	double nsPerInstr;
+	double spread;
+};
+
+uint32_t instrMask[INSTR_COUNT];
+uint32_t instrMatch[INSTR_COUNT];
+
+void loadTable()
+{
+	const uint32_t masks[] = {
+#define INSTR(id, mnemonic, mask, match, format, operands, lift) mask,
+#include "instructions.def"
+#undef INSTR
+	};
+	const uint32_t matches[] = {
+#define INSTR(id, mnemonic, mask, match, format, operands, lift) match,
+#include "instructions.def"
+#undef INSTR
+	};
+	std::copy(std::begin(masks), std::end(masks), instrMask);
+	std::copy(std::begin(matches), std::end(matches), instrMatch);
+}
+
+// Random valid encoding of one of the given instructions
+uint32_t randomWord(std::mt19937& rng, const std::vector<InstrName>& choices)
+{
+	for (;;) {
+		const InstrName name = choices[rng() % choices.size()];
+		const uint32_t word = (rng() & ~instrMask[name]) | instrMatch[name];
+		if (Disassembler::decode(word).mnemonic == name)
+			return word;
+	}
+}
+
+uint16_t randomParcel(std::mt19937& rng)
+{
+	for (;;) {
+		const uint16_t parcel = rng() & 0xffff;
+		if (Compressed::isCompressed(parcel) && Compressed::expand(parcel) != 0
+			&& Disassembler::decode(Compressed::expand(parcel)).type != InstrType::Error)
+			return parcel;
+	}
+}
+
+void appendWord(std::vector<uint8_t>& bytes, uint32_t word)
+{
+	for (int i = 0; i < 4; i++)
+		bytes.push_back((word >> (i * 8)) & 0xff);
+}
+
+void finishStream(Stream& stream)
+{
+	size_t offset = 0;
+	while (offset + 4 <= stream.bytes.size()) {
+		stream.offsets.push_back(offset);
+		const uint16_t parcel = stream.bytes[offset] | (stream.bytes[offset + 1] << 8);
+		offset += Compressed::isCompressed(parcel) ? 2 : 4;
+	}
+}
+
+Stream makeStream(const std::string& name, size_t count, std::mt19937& rng,
+	const std::vector<InstrName>& choices, int compressedPercent)
+{
+	Stream stream { name, {}, {}, compressedPercent == 0 };
+	for (size_t i = 0; i < count; i++) {
+		if ((int)(rng() % 100) < compressedPercent) {
+			const uint16_t parcel = randomParcel(rng);
+			stream.bytes.push_back(parcel & 0xff);
+			stream.bytes.push_back(parcel >> 8);
+		} else
+			appendWord(stream.bytes, randomWord(rng, choices));
+	}
+	finishStream(stream);
+	return stream;
+}
+
+Stream makeGarbage(size_t count, std::mt19937& rng)
+{
+	Stream stream { "garbage", {}, {}, false };
+	for (size_t i = 0; i < count; i++)
+		appendWord(stream.bytes, rng());
+	finishStream(stream);
+	return stream;
+}
+
+std::vector<Stream> makeStreams(size_t count)
+{
+	std::mt19937 rng(0x5eed);
+
+	std::vector<InstrName> all;
+	for (int i = 0; i < INSTR_COUNT; i++)
+		all.push_back((InstrName)i);
+
+	const std::vector<InstrName> branches = { BEQ, BNE, BLT, BGE, BLTU, BGEU, JAL, J, JALR, JR, RET, ADDI };
+	const std::vector<InstrName> memory = { LB, LH, LW, LD, LBU, LHU, LWU, SB, SH, SW, SD, ADDI };
+
+	std::vector<Stream> streams;
+	streams.push_back(makeStream("rv64i", count, rng, all, 0));
+	streams.push_back(makeStream("rv64gc", count, rng, all, 50));
+	streams.push_back(makeStream("branch-heavy", count, rng, branches, 0));
+	streams.push_back(makeStream("load-store-heavy", count, rng, memory, 0));
+	streams.push_back(makeGarbage(count, rng));
+	return streams;
+}
+
+volatile uint64_t sink;
+
+double median(std::vector<double> values)
+{
+	std::sort(values.begin(), values.end());
+	const size_t mid = values.size() / 2;
+	return values.size() % 2 ? values[mid] : (values[mid - 1] + values[mid]) / 2;
+}
+
+struct Measurement {
+	double nsPerInstr;
+	double spread;
+};
+
+// Runs body repeatedly for at least minTime per round and returns the median
+// ns per instruction over the rounds
+Measurement measure(size_t instrs, const std::function<uint64_t()>& body)
+{
+	using Clock = std::chrono::steady_clock;
+	const auto minTime = std::chrono::milliseconds(100);
+	constexpr int Rounds = 9;
+
+	std::vector<double> rounds;
+	for (int round = 0; round < Rounds; round++) {
+		size_t iterations = 0;
+		const auto start = Clock::now();
+		auto now = start;
+		do {
+			sink = sink + body();
+			iterations++;
+			now = Clock::now();
+		} while (now - start < minTime);
+
+		const double ns = std::chrono::duration<double, std::nano>(now - start).count();
+		rounds.push_back(ns / (double)(iterations * instrs));
+	}
+
+	const double ns = median(rounds);
+	std::vector<double> deviations;
+	for (double round : rounds)
+		deviations.push_back(std::abs(round - ns));
+	return { ns, median(deviations) / ns * 100.0 };
+}
+
+// Runs every benchmark, or with only set just the ones it names
+std::vector<Result> runBenchmarks(const std::vector<Stream>& streams, const std::set<std::string>* only = nullptr)
+{
+	std::vector<Result> results;
+	auto record = [&](const std::string& name, size_t instrs, const std::function<uint64_t()>& body) {
+		if (only && !only->count(name))
+			return;
+		const Measurement m = measure(instrs, body);
+		results.push_back({ name, m.nsPerInstr, 1e9 / m.nsPerInstr, m.spread });
+		printf("%-36s %10.2f ns/instr %14.0f instr/s  spread %4.1f%%\n", name.c_str(), m.nsPerInstr,
+			1e9 / m.nsPerInstr, m.spread);
+	};
+
+	for (const Stream& stream : streams) {
+		const uint8_t* data = stream.bytes.data();
+		const size_t count = stream.offsets.size();
+
+		record("disasm/" + stream.name, count, [&]() {
+			uint64_t acc = 0;
+			for (size_t offset : stream.offsets)
+				acc += Disassembler::disasm(data + offset, stream.bytes.size() - offset, 0x10000 + offset).mnemonic;
+			return acc;
+		});
+
+		// A working set that fits the cache, as when the three arch callbacks
+		// ask for the same function
+		const size_t cached = std::min<size_t>(count, 4096);
+		DecodeCache& cache = DecodeCache::instance();
+		cache.clear();
+		const DecodeCache::Stats before = cache.stats();
+		const size_t measured = results.size();
+		record("cache/" + stream.name, cached, [&]() {
+			uint64_t acc = 0;
+			for (size_t i = 0; i < cached; i++) {
+				const size_t offset = stream.offsets[i];
+				acc += DecodeCache::decode(data + offset, 0x10000 + offset, stream.bytes.size() - offset).mnemonic;
+			}
+			return acc;
+		});
+		if (results.size() > measured) {
+			const DecodeCache::Stats after = cache.stats();
+			const uint64_t hits = after.hits - before.hits;
+			const uint64_t misses = after.misses - before.misses;
+			printf("%-36s %10" PRIu64 " hits %14" PRIu64 " misses  hit rate %5.1f%%\n", "", hits, misses,
+				hits + misses ? 100.0 * hits / (hits + misses) : 0.0);
+		}
+
+		if (stream.wordsOnly) {
+			std::vector<Instruction> out(count);
+			record("decodeWords/" + stream.name, count, [&]() {
+				Disassembler::decodeWords((const uint32_t*)data, count, out.data());
+				return (uint64_t)out[count / 2].mnemonic;
+			});
+		}
+
+		std::vector<Instruction> decoded;
+		for (size_t offset : stream.offsets)
+			decoded.push_back(Disassembler::disasm(data + offset, stream.bytes.size() - offset, 0x10000 + offset));
+
+		TokenList tokens;
+		record("render/" + stream.name, count, [&]() {
+			uint64_t acc = 0;
+			for (size_t i = 0; i < count; i++) {
+				Formatter::render(decoded[i], 0x10000 + stream.offsets[i], tokens);
+				acc += tokens.size();
+			}
+			return acc;
+		});
+	}
+	return results;
+}
+
+void writeJson(const std::string& path, const std::vector<Result>& results)
+{
+	std::ofstream out(path);
+	out << "{\n  \"benchmarks\": [\n";
+	for (size_t i = 0; i < results.size(); i++) {
+		char line[256];
+		snprintf(line, sizeof(line),
+			"    { \"name\": \"%s\", \"ns_per_instr\": %.3f, \"instr_per_sec\": %.0f, \"spread_pct\": %.2f }%s\n",
+			results[i].name.c_str(), results[i].nsPerInstr, results[i].instrPerSec, results[i].spread,
+			i + 1 < results.size() ? "," : "");
+		out << line;
+	}
+	out << "  ]\n}\n";
+}
+
+// Reads the name, ns_per_instr and spread_pct of every entry of a file
+// written by writeJson. Entries without a spread have none.
+std::map<std::string, Baseline> readJson(const std::string& path)
+{
+	std::ifstream in(path);
+	std::stringstream buffer;
+	buffer << in.rdbuf();
+	const std::string text = buffer.str();
+
+	std::map<std::string, Baseline> baseline;
+	size_t pos = 0;
+	while ((pos = text.find("\"name\"", pos)) != std::string::npos) {
+		const size_t start = text.find('"', text.find(':', pos)) + 1;
+		const size_t end = text.find('"', start);
+		const std::string name = text.substr(start, end - start);
+		const size_t ns = text.find("\"ns_per_instr\"", end);
+		if (ns == std::string::npos)
+			break;
+		const size_t entryEnd = text.find('}', end);
+		const size_t spread = text.find("\"spread_pct\"", end);
+		baseline[name] = { strtod(text.c_str() + text.find(':', ns) + 1, nullptr),
+			spread < entryEnd ? strtod(text.c_str() + text.find(':', spread) + 1, nullptr) : 0.0 };
+		pos = end;
+	}
+	return baseline;
+}
+
+// Returns the benchmarks slower than the baseline by more than the threshold
+// and by more than three times the spread of the two runs, so noisy
+// benchmarks need a larger change to fail
+std::set<std::string> compare(const std::vector<Result>& results, const std::map<std::string, Baseline>& baseline,
+	double threshold)
+{
+	std::set<std::string> regressions;
+	printf("\n%-36s %10s %10s %8s %8s\n", "benchmark", "baseline", "current", "change", "allowed");
+	for (const Result& result : results) {
+		const auto it = baseline.find(result.name);
+		if (it == baseline.end())
+			continue;
+
+		const Baseline& base = it->second;
+		const double change = (result.nsPerInstr - base.nsPerInstr) / base.nsPerInstr * 100.0;
+		const double allowed = std::max(threshold, 3.0 * (result.spread + base.spread));
+		const bool regressed = change > allowed;
+		printf("%-36s %10.2f %10.2f %+7.1f%% %7.1f%%%s\n", result.name.c_str(), base.nsPerInstr,
+			result.nsPerInstr, change, allowed, regressed ? "  REGRESSION" : "");
+		if (regressed)
+			regressions.insert(result.name);
+	}
+	return regressions;
+}
+}
+
+int main(int argc, char** argv)
+{
+	std::string jsonPath, baselinePath;
+	double threshold = 20.0;
+	size_t count = 1 << 16;
+
+	for (int i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "--json") && i + 1 < argc)
+			jsonPath = argv[++i];
+		else if (!strcmp(argv[i], "--compare") && i + 1 < argc)
+			baselinePath = argv[++i];
+		else if (!strcmp(argv[i], "--threshold") && i + 1 < argc)
+			threshold = atof(argv[++i]);
+		else if (!strcmp(argv[i], "--count") && i + 1 < argc)
+			count = strtoull(argv[++i], nullptr, 0);
+		else {
+			fprintf(stderr, "usage: %s [--json out.json] [--compare baseline.json] [--threshold percent] [--count instrs]\n", argv[0]);
+			return 2;
+		}
+	}
+
+	// The garbage stream is mostly undecodable words, which are only counted
+	Diagnostics::setVerbose(false);
+
+	loadTable();
+	const std::vector<Stream> streams = makeStreams(count);
+	const std::vector<Result> results = runBenchmarks(streams);
+
+	if (!jsonPath.empty())
+		writeJson(jsonPath, results);
+
+	if (!baselinePath.empty()) {
+		const std::map<std::string, Baseline> baseline = readJson(baselinePath);
+		if (baseline.empty()) {
+			fprintf(stderr, "could not read baseline %s\n", baselinePath.c_str());
+			return 2;
+		}
+
+		// Load on a shared machine can last longer than a run, so only
+		// regressions that show up again when re-measured count
+		std::set<std::string> regressions = compare(results, baseline, threshold);
+		for (int retry = 0; retry < 2 && !regressions.empty(); retry++) {
+			printf("\nre-measuring %zu regressed benchmarks\n", regressions.size());
+			regressions = compare(runBenchmarks(streams, &regressions), baseline, threshold);
+		}
+		if (!regressions.empty())
+			return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,645 @@
+// Decoder fuzz target
+//
+// libFuzzer target over the standalone decoder. The input is swept linearly
+// as RV64 and as RV32, and every instruction is checked for:
+//
+//  - the decoded fields re-encoding to the original word
+//  - immediates being in range for their format
+//  - the rendered text parsing back to the same word
+//  - the vectorized decodeWords() agreeing with the scalar decoder
+//  - decodeRange() agreeing with the scalar sweep, and stopping after
+//    control flow and before the first undecodable instruction
+//
+// Built with BN_RISCV_FUZZ_REFERENCE, every instruction is also disassembled
+// with LLVM's RISC-V disassembler, and both must accept the same encodings
+// and agree on the mnemonic, apart from the differences in knownDifference().
+//
+// A failed check prints the instruction and aborts, so libFuzzer saves the input.
+
+#include <algorithm>
+#include <charconv>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#ifdef BN_RISCV_FUZZ_REFERENCE
+#include <llvm-c/Disassembler.h>
+#include <llvm-c/Support.h>
+#include <llvm-c/Target.h>
+#endif
+
+#include "compressed.h"
+#include "csr.h"
+#include "disassembler.h"
+#include "fetch.h"
+#include "formatter.h"
+
+namespace {
+// Address of the first input byte, so targets are printed as addresses
+constexpr uint64_t BaseAddr = 0x10000;
+
+const uint32_t instrMatch[] = {
+#define INSTR(id, mnemonic, mask, match, format, operands, lift) match,
+#include "instructions.def"
+#undef INSTR
+};
+
+const InstrType instrFormat[] = {
+#define INSTR(id, mnemonic, mask, match, format, operands, lift) InstrType::format,
+#include "instructions.def"
+#undef INSTR
+};
+
+[[noreturn]] void fail(const char* check, unsigned xlen, uint32_t insword, const std::string& text = "")
+{
+	fprintf(stderr, "rv%u 0x%08x %s: %s\n", xlen, insword, text.c_str(), check);
+	abort();
+}
+
+std::string rendered(const TokenList& tokens)
+{
+	std::string out;
+	for (const Token& token : tokens)
+		out.append(token.text, token.length);
+	return out;
+}
+
+uint32_t encodeImm(InstrType type, int32_t imm)
+{
+	const uint32_t u = (uint32_t)imm;
+	switch (type) {
+	case Itype:
+		return (u & 0xfff) << 20;
+	case Stype:
+		return ((u >> 5) & 0x7f) << 25 | (u & 0x1f) << 7;
+	case Btype:
+		return ((u >> 12) & 0x1) << 31 | ((u >> 5) & 0x3f) << 25 | ((u >> 1) & 0xf) << 8 | ((u >> 11) & 0x1) << 7;
+	case Utype:
+		return u << 12;
+	case Jtype:
+		return ((u >> 20) & 0x1) << 31 | ((u >> 1) & 0x3ff) << 21 | ((u >> 11) & 0x1) << 20 | ((u >> 12) & 0xff) << 12;
+	default:
+		return 0;
+	}
+}
+
+// Builds the instruction word back from the fields of a decode
+uint32_t encode(const Instruction& instr)
+{
+	uint32_t word = instrMatch[instr.mnemonic] | encodeImm(instr.type, instr.imm);
+	switch (instr.type) {
+	case Rtype:
+		word |= instr.funct7 << 25 | instr.rs2 << 20;
+		// fall through
+	case Itype:
+		word |= instr.rs1 << 15 | instr.funct3 << 12 | instr.rd << 7;
+		break;
+	case Stype:
+	case Btype:
+		word |= instr.rs2 << 20 | instr.rs1 << 15 | instr.funct3 << 12;
+		break;
+	case Utype:
+	case Jtype:
+		word |= instr.rd << 7;
+		break;
+	default:
+		break;
+	}
+	return word;
+}
+
+bool immInRange(const Instruction& instr)
+{
+	const int32_t imm = instr.imm;
+	switch (instr.type) {
+	case Rtype:
+		return imm == 0;
+	case Itype:
+		if (instrOperands[instr.mnemonic] == RdRs1Shamt)
+			return imm >= 0 && imm < 64;
+		// fall through
+	case Stype:
+		return imm >= -2048 && imm < 2048;
+	case Btype:
+		return imm >= -4096 && imm < 4096 && (imm & 1) == 0;
+	case Utype:
+		return imm >= 0 && imm < (1 << 20);
+	case Jtype:
+		return imm >= -(1 << 20) && imm < (1 << 20) && (imm & 1) == 0;
+	default:
+		return false;
+	}
+}
+
+// Reverse lookups of the names the formatter prints
+struct Names {
+	std::unordered_map<std::string_view, InstrName> mnemonics;
+	std::unordered_map<std::string_view, uint32_t> csrs;
+
+	Names()
+	{
+		for (size_t i = 0; i < INSTR_COUNT; i++)
+			mnemonics[instrNames[i]] = (InstrName)i;
+		for (uint32_t number = 0; number < Csr::Count; number++)
+			if (const char* name = Csr::name(number))
+				csrs[name] = number;
+	}
+};
+
+const Names names;
+
+// Reads operands back out of rendered tokens, in the order Formatter prints
+// them. Any token that does not parse clears ok.
+class TokenReader {
+	const TokenList& tokens;
+	size_t next = 3;
+
+	// Moves next past separators and returns true if an operand follows
+	bool skip()
+	{
+		while (next < tokens.size()
+			&& (tokens[next].type == TokenType::Text || tokens[next].type == TokenType::OperandSeparator))
+			next++;
+		return next < tokens.size();
+	}
+
+	const Token* operand(TokenType type)
+	{
+		if (!skip() || tokens[next].type != type) {
+			ok = false;
+			return nullptr;
+		}
+		return &tokens[next++];
+	}
+
+	template <typename T>
+	T number(const Token* token, int base)
+	{
+		T value = 0;
+		if (!token)
+			return value;
+		const char* text = token->text;
+		const char* end = text + token->length;
+		if (base == 16) {
+			if (token->length < 3 || text[0] != '0' || text[1] != 'x') {
+				ok = false;
+				return value;
+			}
+			text += 2;
+		}
+		const auto result = std::from_chars(text, end, value, base);
+		ok = ok && result.ec == std::errc() && result.ptr == end && token->value == (uint64_t)value;
+		return value;
+	}
+
+	// Index of the register in registerNames, first is where the lookup starts
+	uint32_t registerIndex(size_t first, size_t count)
+	{
+		const Token* token = operand(TokenType::Register);
+		if (!token)
+			return 0;
+		const std::string_view text(token->text, token->length);
+		for (size_t i = first; i < first + count; i++)
+			if (text == registerNames[i] && token->value == i)
+				return i;
+		ok = false;
+		return 0;
+	}
+
+public:
+	bool ok = true;
+
+	explicit TokenReader(const TokenList& list)
+		: tokens(list)
+	{
+	}
+
+	uint32_t reg() { return registerIndex(Registers::Zero, 32); }
+
+	uint32_t freg() { return registerIndex(Registers::ft0, 32) - Registers::ft0; }
+
+	int64_t integer() { return number<int64_t>(operand(TokenType::Integer), 10); }
+
+	uint64_t target() { return number<uint64_t>(operand(TokenType::PossibleAddress), 16); }
+
+	int64_t offset() { return number<int64_t>(operand(TokenType::CodeRelativeAddress), 10); }
+
+	// Named CSRs are printed as keywords and the rest as hex numbers
+	uint32_t csr()
+	{
+		if (skip() && tokens[next].type == TokenType::Integer)
+			return number<uint32_t>(operand(TokenType::Integer), 16);
+		const Token* token = operand(TokenType::Keyword);
+		if (!token)
+			return 0;
+		const auto found = names.csrs.find(std::string_view(token->text, token->length));
+		ok = ok && found != names.csrs.end() && token->value == found->second;
+		return ok ? found->second : 0;
+	}
+
+	bool atEnd() { return !skip(); }
+};
+
+// Parses rendered text back into an instruction. The text leaves out the FP
+// rounding mode and the fence fields, so those are taken from decoded.
+bool parse(const TokenList& tokens, uint64_t addr, const Instruction& decoded, Instruction& out)
+{
+	if (tokens.size() < 3 || tokens[0].type != TokenType::Instruction)
+		return false;
+
+	// Atomics print their aq and rl bits as a suffix of the mnemonic
+	static const std::string_view suffixes[4] = { "", ".rl", ".aq", ".aqrl" };
+	const std::string_view mnemonic(tokens[0].text, tokens[0].length);
+	auto found = names.mnemonics.find(mnemonic);
+	uint32_t ordering = 0;
+	for (uint32_t i = 1; i < 4 && found == names.mnemonics.end(); i++) {
+		const std::string_view suffix = suffixes[i];
+		if (mnemonic.size() > suffix.size() && mnemonic.substr(mnemonic.size() - suffix.size()) == suffix) {
+			found = names.mnemonics.find(mnemonic.substr(0, mnemonic.size() - suffix.size()));
+			ordering = i;
+		}
+	}
+	if (found == names.mnemonics.end())
+		return false;
+
+	out = Instruction {};
+	out.mnemonic = found->second;
+	out.type = instrFormat[out.mnemonic];
+	const OperandKind kind = instrOperands[out.mnemonic];
+	if (ordering != 0 && kind != RdAddr && kind != RdRs2Addr)
+		return false;
+	out.funct7 = ordering;
+	if (out.type == Rtype)
+		out.funct3 = decoded.funct3;
+
+	TokenReader r(tokens);
+	switch (kind) {
+	case RdRs1Rs2:
+		out.rd = r.reg();
+		out.rs1 = r.reg();
+		out.rs2 = r.reg();
+		break;
+	case RdRs1Imm:
+	case RdRs1Shamt:
+		out.rd = r.reg();
+		out.rs1 = r.reg();
+		out.imm = r.integer();
+		break;
+	case RdRs1:
+		out.rd = r.reg();
+		out.rs1 = r.reg();
+		break;
+	case RdImm:
+		out.rd = r.reg();
+		out.imm = r.integer();
+		break;
+	case RdMem:
+		out.rd = r.reg();
+		out.imm = r.offset();
+		out.rs1 = r.reg();
+		break;
+	case Rs2Mem:
+		out.rs2 = r.reg();
+		out.imm = r.offset();
+		out.rs1 = r.reg();
+		break;
+	case Rs1Rs2Target:
+		out.rs1 = r.reg();
+		out.rs2 = r.reg();
+		out.imm = r.target() - addr;
+		break;
+	case RdTarget:
+		out.rd = r.reg();
+		out.imm = r.target() - addr;
+		break;
+	case Target:
+		out.imm = r.target() - addr;
+		break;
+	case Rs1:
+		out.rs1 = r.reg();
+		break;
+	case FdFs1Fs2:
+		out.rd = r.freg();
+		out.rs1 = r.freg();
+		out.rs2 = r.freg();
+		break;
+	case FdFs1Fs2Fs3:
+		out.rd = r.freg();
+		out.rs1 = r.freg();
+		out.rs2 = r.freg();
+		out.funct7 = r.freg() << 2;
+		break;
+	case FdFs1:
+		out.rd = r.freg();
+		out.rs1 = r.freg();
+		break;
+	case FdRs1:
+		out.rd = r.freg();
+		out.rs1 = r.reg();
+		break;
+	case RdFs1:
+		out.rd = r.reg();
+		out.rs1 = r.freg();
+		break;
+	case RdFs1Fs2:
+		out.rd = r.reg();
+		out.rs1 = r.freg();
+		out.rs2 = r.freg();
+		break;
+	case FdMem:
+		out.rd = r.freg();
+		out.imm = r.offset();
+		out.rs1 = r.reg();
+		break;
+	case Fs2Mem:
+		out.rs2 = r.freg();
+		out.imm = r.offset();
+		out.rs1 = r.reg();
+		break;
+	case RdAddr:
+		out.rd = r.reg();
+		out.rs1 = r.reg();
+		break;
+	case RdRs2Addr:
+		out.rd = r.reg();
+		out.rs2 = r.reg();
+		out.rs1 = r.reg();
+		break;
+	case RdCsr:
+		out.rd = r.reg();
+		out.imm = r.csr();
+		break;
+	case CsrRs1:
+		out.imm = r.csr();
+		out.rs1 = r.reg();
+		break;
+	case CsrUimm:
+		out.imm = r.csr();
+		out.rs1 = r.integer();
+		break;
+	case RdCsrRs1:
+		out.rd = r.reg();
+		out.imm = r.csr();
+		out.rs1 = r.reg();
+		break;
+	case RdCsrUimm:
+		out.rd = r.reg();
+		out.imm = r.csr();
+		out.rs1 = r.integer();
+		break;
+	case Rs1Rs2:
+		out.rs1 = r.reg();
+		out.rs2 = r.reg();
+		break;
+	case NoOperands:
+		out.rd = decoded.rd;
+		out.rs1 = decoded.rs1;
+		out.imm = decoded.imm;
+		break;
+	}
+	return r.ok && r.atEnd();
+}
+
+#ifdef BN_RISCV_FUZZ_REFERENCE
+// The decoder has entries for some pseudo-instructions, LLVM prints the
+// instruction they stand for
+InstrName baseInstruction(InstrName name)
+{
+	switch (name) {
+	case InstrName::J:
+		return InstrName::JAL;
+	case InstrName::RET:
+	case InstrName::JR:
+		return InstrName::JALR;
+	case InstrName::LI:
+	case InstrName::MV:
+		return InstrName::ADDI;
+	case InstrName::CSRR:
+	case InstrName::CSRS:
+		return InstrName::CSRRS;
+	case InstrName::CSRW:
+		return InstrName::CSRRW;
+	case InstrName::CSRC:
+		return InstrName::CSRRC;
+	case InstrName::CSRWI:
+		return InstrName::CSRRWI;
+	case InstrName::CSRSI:
+		return InstrName::CSRRSI;
+	case InstrName::CSRCI:
+		return InstrName::CSRRCI;
+	default:
+		return name;
+	}
+}
+
+// LLVM 14 accepts some encodings the spec reserves, and rejects some that
+// only set fields the spec says to ignore
+bool knownDifference(unsigned xlen, uint32_t insword, size_t size, const Instruction& instr)
+{
+	const bool decoded = instr.type != InstrType::Error;
+	if (size == 2) {
+		const uint32_t parcel = insword & 0xffff;
+		if (decoded)
+			return false;
+		// The all-zero parcel is defined to be illegal
+		if (parcel == 0)
+			return true;
+		// c.lui with a zero immediate
+		if ((parcel & 0xe003) == 0x6001 && (parcel & 0x107c) == 0)
+			return true;
+		// c.slli, c.srli and c.srai with shamt[5] set on RV32
+		return xlen == 32 && (parcel & 0x1000) && ((parcel & 0xe003) == 0x0002 || (parcel & 0xe803) == 0x8001);
+	}
+
+	if (!decoded) {
+		// slli, srli and srai with shamt[5] set on RV32
+		return xlen == 32 && (insword & 0x02000000) && (insword & 0xbc00307f) == 0x00001013;
+	}
+	switch (instr.mnemonic) {
+	case InstrName::FENCE:
+	case InstrName::FENCE_I:
+	// Exact conversions, which LLVM only accepts with a zero rounding mode
+	case InstrName::FCVT_D_W:
+	case InstrName::FCVT_D_WU:
+	case InstrName::FCVT_D_S:
+		return true;
+	default:
+		break;
+	}
+	// FP operations with the reserved rounding modes 5 and 6
+	const uint32_t opcode = insword & 0x7f;
+	const bool fp = opcode == 0x43 || opcode == 0x47 || opcode == 0x4b || opcode == 0x4f || opcode == 0x53;
+	return fp && (instr.funct3 == 5 || instr.funct3 == 6);
+}
+
+class Reference {
+	LLVMDisasmContextRef rv32;
+	LLVMDisasmContextRef rv64;
+	char text[128];
+
+public:
+	Reference()
+	{
+		// Print instructions rather than the aliases LLVM prefers
+		const char* args[] = { "riscv_decoder_fuzz", "-riscv-no-aliases" };
+		LLVMParseCommandLineOptions(2, args, nullptr);
+		LLVMInitializeRISCVTargetInfo();
+		LLVMInitializeRISCVTargetMC();
+		LLVMInitializeRISCVDisassembler();
+		rv32 = LLVMCreateDisasmCPUFeatures("riscv32", "", "+m,+a,+f,+d,+c", nullptr, 0, nullptr, nullptr);
+		rv64 = LLVMCreateDisasmCPUFeatures("riscv64", "", "+m,+a,+f,+d,+c", nullptr, 0, nullptr, nullptr);
+		if (!rv32 || !rv64) {
+			fprintf(stderr, "LLVM was built without the RISC-V target\n");
+			abort();
+		}
+	}
+
+	// Length of the instruction LLVM decodes, or 0 if it is invalid. The
+	// mnemonic stays valid until the next call.
+	size_t disassemble(unsigned xlen, uint32_t insword, size_t size, std::string_view& mnemonic)
+	{
+		uint8_t bytes[4];
+		memcpy(bytes, &insword, sizeof(bytes));
+		const size_t length
+			= LLVMDisasmInstruction(xlen == 32 ? rv32 : rv64, bytes, size, BaseAddr, text, sizeof(text));
+		const char* start = text + strspn(text, " \t");
+		mnemonic = std::string_view(start, strcspn(start, " \t"));
+		return length;
+	}
+};
+
+void checkReference(unsigned xlen, uint32_t insword, size_t size, const Instruction& instr, const TokenList& tokens)
+{
+	static Reference reference;
+	std::string_view mnemonic;
+	const bool decoded = instr.type != InstrType::Error;
+	const bool referenceDecoded = reference.disassemble(xlen, insword, size, mnemonic) == size;
+	if (decoded != referenceDecoded) {
+		if (!knownDifference(xlen, insword, size, instr))
+			fail(decoded ? "LLVM rejects the instruction" : "LLVM decodes the instruction", xlen, insword,
+				decoded ? rendered(tokens) : std::string(mnemonic));
+		return;
+	}
+
+	// Compressed instructions print as their expansion, LLVM prints the c. form
+	if (!decoded || size == 2)
+		return;
+	const InstrName base = baseInstruction(instr.mnemonic);
+	const std::string_view expected
+		= base == instr.mnemonic ? std::string_view(tokens[0].text, tokens[0].length) : instrNames[base];
+	if (mnemonic != expected)
+		fail("mnemonic differs from LLVM", xlen, insword, rendered(tokens) + " / " + std::string(mnemonic));
+}
+#endif
+
+template <unsigned Xlen>
+void checkInstruction(const uint8_t* data, size_t len, uint64_t addr)
+{
+	const size_t size = Fetch::length(data, len);
+	const uint32_t raw = size == 2 ? Fetch::parcel(data) : Fetch::word(data);
+	const Instruction instr = Disassembler::disasm<Xlen>(data, len, addr);
+	TokenList tokens;
+	Formatter::render<Xlen>(instr, addr, tokens);
+#ifdef BN_RISCV_FUZZ_REFERENCE
+	checkReference(Xlen, raw, size, instr, tokens);
+#endif
+	if (instr.type == InstrType::Error)
+		return;
+
+	// Compressed instructions are checked against their expansion
+	const uint32_t insword = size == 2 ? (Xlen == 32 ? Compressed::expand32(raw) : Compressed::expand(raw)) : raw;
+	if (instr.size != size)
+		fail("wrong size", Xlen, raw, rendered(tokens));
+	if (!immInRange(instr))
+		fail("immediate out of range", Xlen, raw, rendered(tokens));
+	if (encode(instr) != insword)
+		fail("fields do not re-encode to the instruction", Xlen, raw, rendered(tokens));
+
+	Instruction parsed;
+	if (!parse(tokens, addr, instr, parsed))
+		fail("text does not parse", Xlen, raw, rendered(tokens));
+	if (parsed.mnemonic != instr.mnemonic || encode(parsed) != insword)
+		fail("text re-encodes to a different instruction", Xlen, raw, rendered(tokens));
+}
+
+template <unsigned Xlen>
+void sweep(const uint8_t* data, size_t size)
+{
+	size_t offset = 0;
+	while (offset < size) {
+		const size_t length = Fetch::length(data + offset, size - offset);
+		if (length == 0)
+			break;
+		checkInstruction<Xlen>(data + offset, size - offset, BaseAddr + offset);
+		offset += length;
+	}
+}
+
+bool sameFields(const Instruction& a, const Instruction& b)
+{
+	return a.type == b.type && a.mnemonic == b.mnemonic && a.imm == b.imm && a.rd == b.rd && a.rs1 == b.rs1
+		&& a.rs2 == b.rs2 && a.funct3 == b.funct3 && a.funct7 == b.funct7;
+}
+
+template <unsigned Xlen>
+void checkDecodeRange(const uint8_t* data, size_t size)
+{
+	constexpr size_t MaxCount = 16;
+	Instruction block[MaxCount];
+	size_t offset = 0;
+	while (offset < size) {
+		const size_t count = Disassembler::decodeRange<Xlen>(data + offset, size - offset, block, MaxCount);
+		for (size_t i = 0; i < count; i++) {
+			const size_t length = Fetch::length(data + offset, size - offset);
+			const uint32_t raw = length == 2 ? Fetch::parcel(data + offset) : Fetch::word(data + offset);
+			const Instruction scalar = Disassembler::disasm<Xlen>(data + offset, size - offset, BaseAddr + offset);
+			if (scalar.type == InstrType::Error || !sameFields(block[i], scalar) || block[i].size != scalar.size)
+				fail("decodeRange differs from the sweep", Xlen, raw);
+			if (i + 1 < count && Disassembler::isControlFlow(scalar.mnemonic))
+				fail("decodeRange continues past control flow", Xlen, raw);
+			offset += scalar.size;
+		}
+		if (count == MaxCount || (count != 0 && Disassembler::isControlFlow(block[count - 1].mnemonic)))
+			continue;
+
+		// Otherwise the range ends before an undecodable or truncated instruction
+		const size_t length = Fetch::length(data + offset, size - offset);
+		if (length == 0)
+			break;
+		if (Disassembler::disasm<Xlen>(data + offset, size - offset, BaseAddr + offset).type != InstrType::Error)
+			fail("decodeRange stops before a valid instruction", Xlen,
+				length == 2 ? Fetch::parcel(data + offset) : Fetch::word(data + offset));
+		offset += length;
+	}
+}
+
+void checkDecodeWords(const uint8_t* data, size_t size)
+{
+	constexpr size_t MaxWords = 64;
+	uint32_t words[MaxWords] = {};
+	Instruction batch[MaxWords];
+	const size_t count = std::min(size / 4, MaxWords);
+	for (size_t i = 0; i < count; i++)
+		words[i] = Fetch::word(data + i * 4);
+
+	Disassembler::decodeWords(words, count, batch);
+	for (size_t i = 0; i < count; i++) {
+		const Instruction scalar = Disassembler::decode(words[i]);
+		if (!sameFields(batch[i], scalar))
+			fail("decodeWords differs from decode", 64, words[i]);
+	}
+}
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size)
+{
+	sweep<64>(data, size);
+	sweep<32>(data, size);
+	checkDecodeWords(data, size);
+	checkDecodeRange<64>(data, size);
+	checkDecodeRange<32>(data, size);
+	return 0;
+}
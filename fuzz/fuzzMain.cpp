@@ -0,0 +1,85 @@
+// Runs the fuzz target without libFuzzer
+//
+// Compilers without libFuzzer link this driver instead, which replays the
+// given input files and directories, or with no inputs runs random ones:
+//
+//   riscv_decoder_fuzz [-runs=n] [-seed=n] [input...]
+//
+// Random inputs are not mutated or minimized, so this is for replaying
+// crashes and smoke testing rather than finding new bugs.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <vector>
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size);
+
+namespace {
+constexpr size_t MaxRandomSize = 64;
+
+void runFile(const std::filesystem::path& path)
+{
+	std::ifstream file(path, std::ios::binary);
+	const std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	LLVMFuzzerTestOneInput(bytes.data(), bytes.size());
+}
+}
+
+int main(int argc, char** argv)
+{
+	uint64_t runs = 1 << 20;
+	uint64_t seed = 1;
+	std::vector<std::filesystem::path> inputs;
+	for (int i = 1; i < argc; i++) {
+		if (!strncmp(argv[i], "-runs=", 6))
+			runs = strtoull(argv[i] + 6, nullptr, 0);
+		else if (!strncmp(argv[i], "-seed=", 6))
+			seed = strtoull(argv[i] + 6, nullptr, 0);
+		else if (argv[i][0] == '-') {
+			fprintf(stderr, "usage: %s [-runs=n] [-seed=n] [input...]\n", argv[0]);
+			return 2;
+		} else
+			inputs.push_back(argv[i]);
+	}
+
+	const auto start = std::chrono::steady_clock::now();
+	uint64_t executed = 0;
+	if (!inputs.empty()) {
+		for (const auto& input : inputs) {
+			if (std::filesystem::is_directory(input)) {
+				for (const auto& entry : std::filesystem::directory_iterator(input)) {
+					runFile(entry.path());
+					executed++;
+				}
+			} else {
+				runFile(input);
+				executed++;
+			}
+		}
+	} else {
+		std::mt19937_64 rng(seed);
+		uint8_t data[MaxRandomSize];
+		for (; executed < runs; executed++) {
+			const size_t size = rng() % (MaxRandomSize + 1);
+			for (size_t i = 0; i < size; i += 8) {
+				const uint64_t bits = rng();
+				memcpy(data + i, &bits, std::min<size_t>(8, size - i));
+			}
+			LLVMFuzzerTestOneInput(data, size);
+		}
+	}
+
+	const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	printf("executed %llu inputs in %.2f s (%.0f/s)\n", (unsigned long long)executed, seconds,
+		seconds > 0 ? executed / seconds : 0.0);
+	return 0;
+}
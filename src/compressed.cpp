@@ -0,0 +1,273 @@
+#include "compressed.h"
+
+#include <array>
+
+namespace {
+// Field encoders for the expanded 32-bit form
+constexpr uint32_t encR(uint32_t funct7, uint32_t rs2, uint32_t rs1, uint32_t funct3, uint32_t rd, uint32_t opcode)
+{
+	return (funct7 << 25) | (rs2 << 20) | (rs1 << 15) | (funct3 << 12) | (rd << 7) | opcode;
+}
+
+constexpr uint32_t encI(int32_t imm, uint32_t rs1, uint32_t funct3, uint32_t rd, uint32_t opcode)
+{
+	return (((uint32_t)imm & 0xfff) << 20) | (rs1 << 15) | (funct3 << 12) | (rd << 7) | opcode;
+}
+
+constexpr uint32_t encS(int32_t imm, uint32_t rs2, uint32_t rs1, uint32_t funct3, uint32_t opcode)
+{
+	return ((((uint32_t)imm >> 5) & 0x7f) << 25) | (rs2 << 20) | (rs1 << 15) | (funct3 << 12)
+		| (((uint32_t)imm & 0x1f) << 7) | opcode;
+}
+
+constexpr uint32_t encB(int32_t imm, uint32_t rs2, uint32_t rs1, uint32_t funct3, uint32_t opcode)
+{
+	return ((((uint32_t)imm >> 12) & 0x1) << 31) | ((((uint32_t)imm >> 5) & 0x3f) << 25)
+		| (rs2 << 20) | (rs1 << 15) | (funct3 << 12) | ((((uint32_t)imm >> 1) & 0xf) << 8)
+		| ((((uint32_t)imm >> 11) & 0x1) << 7) | opcode;
+}
+
+constexpr uint32_t encU(int32_t imm, uint32_t rd, uint32_t opcode)
+{
+	return (((uint32_t)imm & 0xfffff) << 12) | (rd << 7) | opcode;
+}
+
+constexpr uint32_t encJ(int32_t imm, uint32_t rd, uint32_t opcode)
+{
+	return ((((uint32_t)imm >> 20) & 0x1) << 31) | ((((uint32_t)imm >> 1) & 0x3ff) << 21)
+		| ((((uint32_t)imm >> 11) & 0x1) << 20) | ((((uint32_t)imm >> 12) & 0xff) << 12)
+		| (rd << 7) | opcode;
+}
+
+// Extracts bits [hi:lo] of the parcel and places them at bit position pos
+constexpr uint32_t bits(uint32_t parcel, uint32_t hi, uint32_t lo, uint32_t pos)
+{
+	return ((parcel >> lo) & ((1u << (hi - lo + 1)) - 1)) << pos;
+}
+
+constexpr int32_t signExtend(uint32_t value, uint32_t width)
+{
+	const uint32_t sign = 1u << (width - 1);
+	return (int32_t)((value ^ sign) - sign);
+}
+
+constexpr uint32_t OP_LOAD = 0b0000011;
+constexpr uint32_t OP_LOAD_FP = 0b0000111;
+constexpr uint32_t OP_IMM = 0b0010011;
+constexpr uint32_t OP_IMM_32 = 0b0011011;
+constexpr uint32_t OP_STORE = 0b0100011;
+constexpr uint32_t OP_STORE_FP = 0b0100111;
+constexpr uint32_t OP = 0b0110011;
+constexpr uint32_t OP_32 = 0b0111011;
+constexpr uint32_t OP_LUI = 0b0110111;
+constexpr uint32_t OP_BRANCH = 0b1100011;
+constexpr uint32_t OP_JALR = 0b1100111;
+constexpr uint32_t OP_JAL = 0b1101111;
+constexpr uint32_t EBREAK = 0x00100073;
+
+constexpr uint32_t Illegal = 0;
+
+constexpr uint32_t expandQuadrant0(uint32_t c)
+{
+	// rd'/rs2' and rs1' name x8-x15
+	const uint32_t rdp = bits(c, 4, 2, 0) + 8;
+	const uint32_t rs1p = bits(c, 9, 7, 0) + 8;
+	const uint32_t uimmW = bits(c, 12, 10, 3) | bits(c, 6, 6, 2) | bits(c, 5, 5, 6);
+	const uint32_t uimmD = bits(c, 12, 10, 3) | bits(c, 6, 5, 6);
+
+	switch (bits(c, 15, 13, 0)) {
+	case 0b000: { // c.addi4spn
+		const uint32_t nzuimm = bits(c, 12, 11, 4) | bits(c, 10, 7, 6) | bits(c, 6, 6, 2) | bits(c, 5, 5, 3);
+		if (nzuimm == 0)
+			return Illegal;
+		return encI(nzuimm, 2, 0b000, rdp, OP_IMM);
+	}
+	case 0b001: // c.fld
+		return encI(uimmD, rs1p, 0b011, rdp, OP_LOAD_FP);
+	case 0b010: // c.lw
+		return encI(uimmW, rs1p, 0b010, rdp, OP_LOAD);
+	case 0b011: // c.ld
+		return encI(uimmD, rs1p, 0b011, rdp, OP_LOAD);
+	case 0b101: // c.fsd
+		return encS(uimmD, rdp, rs1p, 0b011, OP_STORE_FP);
+	case 0b110: // c.sw
+		return encS(uimmW, rdp, rs1p, 0b010, OP_STORE);
+	case 0b111: // c.sd
+		return encS(uimmD, rdp, rs1p, 0b011, OP_STORE);
+	default:
+		return Illegal;
+	}
+}
+
+constexpr uint32_t expandQuadrant1(uint32_t c)
+{
+	const uint32_t rd = bits(c, 11, 7, 0);
+	const uint32_t rdp = bits(c, 9, 7, 0) + 8;
+	const uint32_t rs2p = bits(c, 4, 2, 0) + 8;
+	const int32_t imm6 = signExtend(bits(c, 12, 12, 5) | bits(c, 6, 2, 0), 6);
+
+	switch (bits(c, 15, 13, 0)) {
+	case 0b000: // c.addi, c.nop
+		return encI(imm6, rd, 0b000, rd, OP_IMM);
+	case 0b001: // c.addiw
+		if (rd == 0)
+			return Illegal;
+		return encI(imm6, rd, 0b000, rd, OP_IMM_32);
+	case 0b010: // c.li
+		return encI(imm6, 0, 0b000, rd, OP_IMM);
+	case 0b011: {
+		if (rd == 2) { // c.addi16sp
+			const int32_t nzimm = signExtend(bits(c, 12, 12, 9) | bits(c, 6, 6, 4) | bits(c, 5, 5, 6)
+					| bits(c, 4, 3, 7) | bits(c, 2, 2, 5),
+				10);
+			if (nzimm == 0)
+				return Illegal;
+			return encI(nzimm, 2, 0b000, 2, OP_IMM);
+		}
+		// c.lui
+		if (imm6 == 0)
+			return Illegal;
+		return encU(imm6, rd, OP_LUI);
+	}
+	case 0b100: {
+		const uint32_t shamt = bits(c, 12, 12, 5) | bits(c, 6, 2, 0);
+		switch (bits(c, 11, 10, 0)) {
+		case 0b00: // c.srli
+			return encI(shamt, rdp, 0b101, rdp, OP_IMM);
+		case 0b01: // c.srai
+			return encI(shamt | 0x400, rdp, 0b101, rdp, OP_IMM);
+		case 0b10: // c.andi
+			return encI(imm6, rdp, 0b111, rdp, OP_IMM);
+		default:
+			break;
+		}
+
+		switch (bits(c, 12, 12, 2) | bits(c, 6, 5, 0)) {
+		case 0b000: // c.sub
+			return encR(0b0100000, rs2p, rdp, 0b000, rdp, OP);
+		case 0b001: // c.xor
+			return encR(0b0000000, rs2p, rdp, 0b100, rdp, OP);
+		case 0b010: // c.or
+			return encR(0b0000000, rs2p, rdp, 0b110, rdp, OP);
+		case 0b011: // c.and
+			return encR(0b0000000, rs2p, rdp, 0b111, rdp, OP);
+		case 0b100: // c.subw
+			return encR(0b0100000, rs2p, rdp, 0b000, rdp, OP_32);
+		case 0b101: // c.addw
+			return encR(0b0000000, rs2p, rdp, 0b000, rdp, OP_32);
+		default:
+			return Illegal;
+		}
+	}
+	case 0b101: { // c.j
+		const int32_t imm = signExtend(bits(c, 12, 12, 11) | bits(c, 11, 11, 4) | bits(c, 10, 9, 8)
+				| bits(c, 8, 8, 10) | bits(c, 7, 7, 6) | bits(c, 6, 6, 7) | bits(c, 5, 3, 1)
+				| bits(c, 2, 2, 5),
+			12);
+		return encJ(imm, 0, OP_JAL);
+	}
+	default: { // c.beqz, c.bnez
+		const int32_t imm = signExtend(bits(c, 12, 12, 8) | bits(c, 11, 10, 3) | bits(c, 6, 5, 6)
+				| bits(c, 4, 3, 1) | bits(c, 2, 2, 5),
+			9);
+		return encB(imm, 0, rdp, bits(c, 13, 13, 0), OP_BRANCH);
+	}
+	}
+}
+
+constexpr uint32_t expandQuadrant2(uint32_t c)
+{
+	const uint32_t rd = bits(c, 11, 7, 0);
+	const uint32_t rs2 = bits(c, 6, 2, 0);
+
+	switch (bits(c, 15, 13, 0)) {
+	case 0b000: // c.slli
+		return encI(bits(c, 12, 12, 5) | bits(c, 6, 2, 0), rd, 0b001, rd, OP_IMM);
+	case 0b001: // c.fldsp
+		return encI(bits(c, 12, 12, 5) | bits(c, 6, 5, 3) | bits(c, 4, 2, 6), 2, 0b011, rd, OP_LOAD_FP);
+	case 0b010: // c.lwsp
+		if (rd == 0)
+			return Illegal;
+		return encI(bits(c, 12, 12, 5) | bits(c, 6, 4, 2) | bits(c, 3, 2, 6), 2, 0b010, rd, OP_LOAD);
+	case 0b011: // c.ldsp
+		if (rd == 0)
+			return Illegal;
+		return encI(bits(c, 12, 12, 5) | bits(c, 6, 5, 3) | bits(c, 4, 2, 6), 2, 0b011, rd, OP_LOAD);
+	case 0b100:
+		if (bits(c, 12, 12, 0) == 0) {
+			if (rs2 == 0) { // c.jr
+				if (rd == 0)
+					return Illegal;
+				return encI(0, rd, 0b000, 0, OP_JALR);
+			}
+			// c.mv
+			return encR(0b0000000, rs2, 0, 0b000, rd, OP);
+		}
+		if (rs2 == 0) {
+			if (rd == 0) // c.ebreak
+				return EBREAK;
+			// c.jalr
+			return encI(0, rd, 0b000, 1, OP_JALR);
+		}
+		// c.add
+		return encR(0b0000000, rs2, rd, 0b000, rd, OP);
+	case 0b101: // c.fsdsp
+		return encS(bits(c, 12, 10, 3) | bits(c, 9, 7, 6), rs2, 2, 0b011, OP_STORE_FP);
+	case 0b110: // c.swsp
+		return encS(bits(c, 12, 9, 2) | bits(c, 8, 7, 6), rs2, 2, 0b010, OP_STORE);
+	default: // c.sdsp
+		return encS(bits(c, 12, 10, 3) | bits(c, 9, 7, 6), rs2, 2, 0b011, OP_STORE);
+	}
+}
+
+constexpr uint32_t expandParcel(uint32_t parcel)
+{
+	switch (parcel & 0b11) {
+	case 0b00:
+		return expandQuadrant0(parcel);
+	case 0b01:
+		return expandQuadrant1(parcel);
+	case 0b10:
+		return expandQuadrant2(parcel);
+	default:
+		return Illegal;
+	}
+}
+
+constexpr std::array<uint32_t, 1 << 16> buildExpansionTable()
+{
+	std::array<uint32_t, 1 << 16> table {};
+	for (uint32_t parcel = 0; parcel < table.size(); parcel++)
+		table[parcel] = expandParcel(parcel);
+	return table;
+}
+
+constexpr std::array<uint32_t, 1 << 16> expansionTable = buildExpansionTable();
+}
+
+uint32_t Compressed::expand(uint16_t parcel)
+{
+	return expansionTable[parcel];
+}
+
+uint32_t Compressed::expand32(uint16_t parcel)
+{
+	const uint32_t c = parcel;
+	switch (c & 0xe003) {
+	case 0x6000: // c.flw
+		return encI(bits(c, 12, 10, 3) | bits(c, 6, 6, 2) | bits(c, 5, 5, 6), bits(c, 9, 7, 0) + 8, 0b010,
+			bits(c, 4, 2, 0) + 8, OP_LOAD_FP);
+	case 0xe000: // c.fsw
+		return encS(bits(c, 12, 10, 3) | bits(c, 6, 6, 2) | bits(c, 5, 5, 6), bits(c, 4, 2, 0) + 8,
+			bits(c, 9, 7, 0) + 8, 0b010, OP_STORE_FP);
+	case 0x2001: // c.jal has the c.j immediate and links through ra
+		return expansionTable[(c & ~0xe000u) | 0xa000] | (1u << 7);
+	case 0x6002: // c.flwsp
+		return encI(bits(c, 12, 12, 5) | bits(c, 6, 4, 2) | bits(c, 3, 2, 6), 2, 0b010, bits(c, 11, 7, 0),
+			OP_LOAD_FP);
+	case 0xe002: // c.fswsp
+		return encS(bits(c, 12, 9, 2) | bits(c, 8, 7, 6), bits(c, 6, 2, 0), 2, 0b010, OP_STORE_FP);
+	default:
+		return expansionTable[parcel];
+	}
+}
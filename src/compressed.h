@@ -0,0 +1,26 @@
+#ifndef BN_RISCV_ARCH_COMPRESSED_H
+#define BN_RISCV_ARCH_COMPRESSED_H
+
+#include <cstdint>
+
+// RVC (C extension) support. Every 16-bit parcel maps to the 32-bit
+// instruction it is shorthand for, so compressed code runs through the
+// normal decoder, printer and lifter once it has been expanded.
+class Compressed {
+public:
+	// True if the parcel starts a 16-bit instruction rather than a 32-bit one
+	static bool isCompressed(uint16_t parcel)
+	{
+		return (parcel & 0b11) != 0b11;
+	}
+
+	// Returns the 32-bit equivalent of a compressed instruction, or 0 if the
+	// parcel is an illegal or reserved encoding
+	static uint32_t expand(uint16_t parcel);
+
+	// Same as expand() for RV32C, which gives the RV64 c.ld, c.sd, c.ldsp,
+	// c.sdsp and c.addiw encodings to c.flw, c.fsw, c.flwsp, c.fswsp and c.jal
+	static uint32_t expand32(uint16_t parcel);
+};
+
+#endif // BN_RISCV_ARCH_COMPRESSED_H
@@ -0,0 +1,21 @@
+#include "csr.h"
+
+namespace {
+struct CsrNames {
+	const char* names[Csr::Count] {};
+
+	constexpr CsrNames()
+	{
+#define CSR(number, name) names[number] = name;
+#include "csrs.def"
+#undef CSR
+	}
+};
+
+constexpr CsrNames csrNames;
+}
+
+const char* Csr::name(uint32_t number)
+{
+	return number < Count ? csrNames.names[number] : nullptr;
+}
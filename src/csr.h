@@ -0,0 +1,20 @@
+#ifndef BN_RISCV_ARCH_CSR_H
+#define BN_RISCV_ARCH_CSR_H
+
+#include <cstdint>
+
+enum CsrNumber : uint32_t {
+	CsrMepc = 0x341,
+	CsrSepc = 0x141
+};
+
+// Names of the control and status registers in csrs.def
+class Csr {
+public:
+	static constexpr uint32_t Count = 4096;
+
+	// Name of a 12-bit CSR number, or nullptr if it has none
+	static const char* name(uint32_t number);
+};
+
+#endif // BN_RISCV_ARCH_CSR_H
@@ -0,0 +1,116 @@
+#include "decodeCache.h"
+#include "fetch.h"
+
+#include <cstring>
+
+template <unsigned Xlen>
+DecodeCache& DecodeCache::instance()
+{
+	static DecodeCache cache;
+	return cache;
+}
+
+template DecodeCache& DecodeCache::instance<32>();
+template DecodeCache& DecodeCache::instance<64>();
+
+// The cache key is the instruction word itself, which for a compressed
+// instruction is only the first 16 bits
+static uint32_t keyWord(const uint8_t* data, size_t size)
+{
+	return size == 2 ? Fetch::parcel(data) : Fetch::word(data);
+}
+
+template <unsigned Xlen>
+Instruction DecodeCache::decode(const uint8_t* data, uint64_t addr, size_t len)
+{
+	const size_t size = Fetch::length(data, len);
+	if (size == 0)
+		return Instruction {};
+
+	DecodeCache& cache = instance<Xlen>();
+	static thread_local Counters& counters = cache.threadCounters();
+	Instruction instr;
+	if (cache.lookup(addr, keyWord(data, size), instr)) {
+		counters.hits.store(counters.hits.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+		return instr;
+	}
+	counters.misses.store(counters.misses.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+
+	// Binary Ninja only passes the bytes of one instruction to the callbacks,
+	// so there is nothing to decode ahead
+	instr = Disassembler::disasm<Xlen>(data, len, addr);
+	cache.insert(addr, keyWord(data, size), instr);
+	return instr;
+}
+
+template Instruction DecodeCache::decode<32>(const uint8_t* data, uint64_t addr, size_t len);
+template Instruction DecodeCache::decode<64>(const uint8_t* data, uint64_t addr, size_t len);
+
+size_t DecodeCache::slot(uint64_t addr, uint32_t insword)
+{
+	// Instructions are at least 2-byte aligned, so the low bit carries no information
+	const uint64_t hash = ((addr >> 1) ^ ((uint64_t)insword << 17)) * 0x9e3779b97f4a7c15ULL;
+	return hash >> (64 - IndexBits);
+}
+
+bool DecodeCache::lookup(uint64_t addr, uint32_t insword, Instruction& out) const
+{
+	const Entry& entry = entries[slot(addr, insword)];
+	const uint32_t before = entry.sequence.load(std::memory_order_acquire);
+	if (before == 0 || (before & 1))
+		return false;
+
+	const uint64_t instr[2] = { entry.instr[0].load(std::memory_order_relaxed),
+		entry.instr[1].load(std::memory_order_relaxed) };
+	const bool match = entry.addr.load(std::memory_order_relaxed) == addr
+		&& entry.insword.load(std::memory_order_relaxed) == insword;
+
+	// Orders the field loads before the second sequence load
+	std::atomic_thread_fence(std::memory_order_acquire);
+	if (!match || entry.sequence.load(std::memory_order_relaxed) != before)
+		return false;
+	memcpy(&out, instr, sizeof(out));
+	return true;
+}
+
+void DecodeCache::insert(uint64_t addr, uint32_t insword, const Instruction& instr)
+{
+	Entry& entry = entries[slot(addr, insword)];
+	uint32_t sequence = entry.sequence.load(std::memory_order_relaxed);
+	if ((sequence & 1) || !entry.sequence.compare_exchange_strong(sequence, sequence + 1, std::memory_order_acquire))
+		return;
+
+	// Orders the odd sequence before the field stores
+	std::atomic_thread_fence(std::memory_order_release);
+	uint64_t words[2] = {};
+	memcpy(words, &instr, sizeof(instr));
+	entry.addr.store(addr, std::memory_order_relaxed);
+	entry.insword.store(insword, std::memory_order_relaxed);
+	entry.instr[0].store(words[0], std::memory_order_relaxed);
+	entry.instr[1].store(words[1], std::memory_order_relaxed);
+	entry.sequence.store(sequence + 2, std::memory_order_release);
+}
+
+DecodeCache::Counters& DecodeCache::threadCounters()
+{
+	std::lock_guard<std::mutex> guard(countersLock);
+	counters.push_back(std::make_unique<Counters>());
+	return *counters.back();
+}
+
+DecodeCache::Stats DecodeCache::stats() const
+{
+	std::lock_guard<std::mutex> guard(countersLock);
+	Stats total = {};
+	for (const auto& thread : counters) {
+		total.hits += thread->hits.load(std::memory_order_relaxed);
+		total.misses += thread->misses.load(std::memory_order_relaxed);
+	}
+	return total;
+}
+
+void DecodeCache::clear()
+{
+	for (Entry& entry : entries)
+		entry.sequence.store(0, std::memory_order_relaxed);
+}
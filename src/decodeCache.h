@@ -0,0 +1,78 @@
+#ifndef BN_RISCV_ARCH_DECODECACHE_H
+#define BN_RISCV_ARCH_DECODECACHE_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "disassembler.h"
+
+// Binary Ninja asks for the info, text and IL of an address through three
+// separate callbacks. This cache lets them share a single decode of the
+// instruction word. It is direct-mapped and every slot is a seqlock, so a
+// hit takes no lock and writes nothing shared. Writers that race for a slot
+// skip the insert rather than wait.
+class DecodeCache {
+public:
+	static constexpr unsigned IndexBits = 16;
+	static constexpr size_t Capacity = (size_t)1 << IndexBits;
+
+	struct Stats {
+		uint64_t hits;
+		uint64_t misses;
+	};
+
+	// RV32 and RV64 decode some words differently, so each XLEN has its own cache
+	template <unsigned Xlen = 64>
+	static DecodeCache& instance();
+
+	// Decodes the instruction at data, reusing a previous decode of the same
+	// (addr, instruction word) pair when one is cached. Undecodable words are
+	// cached too, so their diagnostics are recorded once per address.
+	template <unsigned Xlen = 64>
+	static Instruction decode(const uint8_t* data, uint64_t addr, size_t len);
+
+	bool lookup(uint64_t addr, uint32_t insword, Instruction& out) const;
+
+	void insert(uint64_t addr, uint32_t insword, const Instruction& instr);
+
+	// Must not race with insert()
+	void clear();
+
+	// Hits and misses of decode() so far, summed over the threads
+	Stats stats() const;
+
+private:
+	// Each thread counts its own lookups on its own cache line, so counting a
+	// hit writes nothing shared. Only the owning thread writes its counters.
+	struct alignas(64) Counters {
+		std::atomic<uint64_t> hits { 0 };
+		std::atomic<uint64_t> misses { 0 };
+	};
+
+	// The sequence is odd while a writer fills the slot and 0 while it is
+	// empty. Fields are atomics so a reader racing a writer is not a data
+	// race, it just sees the sequence change and misses.
+	struct alignas(32) Entry {
+		std::atomic<uint32_t> sequence { 0 };
+		std::atomic<uint32_t> insword { 0 };
+		std::atomic<uint64_t> addr { 0 };
+		std::atomic<uint64_t> instr[2] {};
+	};
+
+	static_assert(sizeof(Instruction) <= sizeof(Entry::instr), "Instruction must fit a cache entry");
+
+	static size_t slot(uint64_t addr, uint32_t insword);
+
+	Counters& threadCounters();
+
+	Entry entries[Capacity];
+
+	mutable std::mutex countersLock;
+	// Kept after their thread exits so its counts are still summed
+	std::vector<std::unique_ptr<Counters>> counters;
+};
+
+#endif // BN_RISCV_ARCH_DECODECACHE_H
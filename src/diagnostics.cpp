@@ -0,0 +1,174 @@
+#include "diagnostics.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdarg>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace {
+struct ViewCounts {
+	uint64_t start;
+	uint64_t end;
+	bool verbose = false;
+	uint64_t undecodable[Diagnostics::OpcodeCount] = {};
+	std::chrono::steady_clock::time_point lastSummary;
+	bool summarized = false;
+};
+}
+
+static std::atomic<bool> verboseLogging { false };
+
+// The decode cache records a word once per address, so recording is rare
+// enough for a single lock over every view
+static std::mutex viewsLock;
+static std::unordered_map<Diagnostics::ViewKey, ViewCounts> views;
+
+static void stderrHook(Diagnostics::Level level, const char* message)
+{
+	static const char* levelNames[] = { "debug", "info", "warning", "error" };
+	fprintf(stderr, "riscv [%s]: %s\n", levelNames[level], message);
+}
+
+static std::atomic<Diagnostics::Hook> hook { stderrHook };
+
+static void emit(Diagnostics::Level level, const char* fmt, ...)
+{
+	char message[512];
+	va_list args;
+	va_start(args, fmt);
+	vsnprintf(message, sizeof(message), fmt, args);
+	va_end(args);
+	hook.load(std::memory_order_relaxed)(level, message);
+}
+
+void Diagnostics::setHook(Hook newHook)
+{
+	hook.store(newHook ? newHook : stderrHook, std::memory_order_relaxed);
+}
+
+void Diagnostics::recordUndecodable(uint64_t addr, uint32_t insword)
+{
+	const uint32_t opcode = insword & 0x7f;
+	bool counted = false;
+	bool verbose = false;
+	{
+		std::lock_guard<std::mutex> guard(viewsLock);
+		for (auto& [key, counts] : views) {
+			if (addr < counts.start || addr >= counts.end)
+				continue;
+			counts.undecodable[opcode]++;
+			verbose |= counts.verbose;
+			counted = true;
+		}
+	}
+
+	if (counted ? verbose : verboseLogging.load(std::memory_order_relaxed))
+		emit(Error, "Unimplemented instr - Addr: 0x%llx, Opcode: 0x%x, funct3: 0x%x",
+			(unsigned long long)addr, opcode, (insword >> 12) & 0x7);
+}
+
+void Diagnostics::openView(ViewKey view, uint64_t start, uint64_t end)
+{
+	std::lock_guard<std::mutex> guard(viewsLock);
+	ViewCounts& counts = views[view];
+	counts.start = start;
+	counts.end = end;
+}
+
+void Diagnostics::setVerbose(bool verbose)
+{
+	verboseLogging.store(verbose, std::memory_order_relaxed);
+}
+
+void Diagnostics::setVerbose(ViewKey view, bool verbose)
+{
+	std::lock_guard<std::mutex> guard(viewsLock);
+	const auto it = views.find(view);
+	if (it != views.end())
+		it->second.verbose = verbose;
+}
+
+bool Diagnostics::isVerbose()
+{
+	return verboseLogging.load(std::memory_order_relaxed);
+}
+
+// Takes the view's counts and returns their summary, or an empty string
+// when there is nothing to report
+static std::string summarize(ViewCounts& view)
+{
+	std::vector<std::pair<uint64_t, uint32_t>> counts;
+	uint64_t total = 0;
+	for (uint32_t opcode = 0; opcode < Diagnostics::OpcodeCount; opcode++) {
+		const uint64_t count = view.undecodable[opcode];
+		view.undecodable[opcode] = 0;
+		if (count == 0)
+			continue;
+		counts.emplace_back(count, opcode);
+		total += count;
+	}
+
+	if (total == 0)
+		return {};
+
+	// Only the most frequent opcodes are worth reporting
+	std::sort(counts.rbegin(), counts.rend());
+	if (counts.size() > 8)
+		counts.resize(8);
+
+	std::string byOpcode;
+	for (const auto& [count, opcode] : counts) {
+		char buf[48];
+		snprintf(buf, sizeof(buf), "%s0x%02x: %llu", byOpcode.empty() ? "" : ", ", opcode,
+			(unsigned long long)count);
+		byOpcode += buf;
+	}
+
+	char summary[512];
+	snprintf(summary, sizeof(summary), "RISC-V: %llu undecodable words during analysis (by opcode %s)",
+		(unsigned long long)total, byOpcode.c_str());
+	return summary;
+}
+
+void Diagnostics::flush(ViewKey view)
+{
+	std::string summary;
+	{
+		std::lock_guard<std::mutex> guard(viewsLock);
+		const auto it = views.find(view);
+		if (it == views.end())
+			return;
+
+		ViewCounts& counts = it->second;
+		const auto now = std::chrono::steady_clock::now();
+		if (counts.summarized && now - counts.lastSummary < std::chrono::seconds(MinSummaryInterval))
+			return;
+		summary = summarize(counts);
+		if (summary.empty())
+			return;
+		counts.lastSummary = now;
+		counts.summarized = true;
+	}
+	emit(Warning, "%s", summary.c_str());
+}
+
+void Diagnostics::closeView(ViewKey view)
+{
+	std::string summary;
+	{
+		std::lock_guard<std::mutex> guard(viewsLock);
+		const auto it = views.find(view);
+		if (it == views.end())
+			return;
+		summary = summarize(it->second);
+		views.erase(it);
+	}
+	if (!summary.empty())
+		emit(Warning, "%s", summary.c_str());
+}
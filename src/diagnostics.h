@@ -0,0 +1,59 @@
+#ifndef BN_RISCV_ARCH_DIAGNOSTICS_H
+#define BN_RISCV_ARCH_DIAGNOSTICS_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Aggregates decoder failures so that sweeping over data does not emit a log
+// line per undecodable word. Counts are kept per view and per major opcode
+// and reported as a single summary when flush() is called at the end of an
+// analysis pass.
+//
+// The decoder is not told which view it decodes for, so a word counts for
+// every open view whose image covers its address. Words outside every view,
+// as in the standalone tools, are only logged when verbose and not counted.
+class Diagnostics {
+public:
+	// Identifies a view, the plugin uses the core's view handle
+	typedef const void* ViewKey;
+
+	static constexpr size_t OpcodeCount = 128;
+	// Seconds between summaries
+	static constexpr unsigned MinSummaryInterval = 5;
+
+	enum Level {
+		Debug,
+		Info,
+		Warning,
+		Error
+	};
+
+	typedef void (*Hook)(Level level, const char* message);
+
+	// Receives every message, they are printed to stderr until a hook is set
+	static void setHook(Hook hook);
+
+	static void recordUndecodable(uint64_t addr, uint32_t insword);
+
+	// Starts counting the words in [start, end) for the view
+	static void openView(ViewKey view, uint64_t start, uint64_t end);
+
+	// Logs the counts held back since the view's last summary and stops
+	// counting for it. Does nothing for views that were never opened.
+	static void closeView(ViewKey view);
+
+	// Also log every undecodable word with its address as it is seen. The
+	// first form is for words outside every view.
+	static void setVerbose(bool verbose);
+	static void setVerbose(ViewKey view, bool verbose);
+
+	static bool isVerbose();
+
+	// Logs a summary of the view's words since its last summary and resets
+	// its counters. Summaries of a view are at least MinSummaryInterval apart,
+	// a flush that comes sooner keeps the counts for the next one or for
+	// closeView().
+	static void flush(ViewKey view);
+};
+
+#endif // BN_RISCV_ARCH_DIAGNOSTICS_H
@@ -1,310 +1,324 @@
 #include "disassembler.h"
+#include "compressed.h"
+#include "diagnostics.h"
+#include "fetch.h"
+#include "fieldExtract.h"
+#include "profiler.h"
 
-Instruction Disassembler::disasm(const uint8_t* data, uint64_t addr)
-{
-	uint32_t* insdword = (uint32_t*)data;
-
-	const uint8_t opcode = *insdword & 0b1111111;
-	Instruction instr {
-		.type = InstrType::Error,
-	};
+namespace {
+struct InstrDesc {
+	uint32_t mask;
+	uint32_t match;
+	InstrName name;
+	InstrType format;
+	bool rv64Only;
+};
 
+// Instructions that only exist on RV64: the W forms, 64-bit loads, stores and
+// atomics, and the FP conversions and moves to and from 64-bit integers
+constexpr bool isRv64Only(uint32_t match)
+{
+	const uint32_t opcode = match & 0x7f;
+	const uint32_t funct3 = (match >> 12) & 0b111;
+	const uint32_t funct7 = match >> 25;
 	switch (opcode) {
-	case 0b0110111: { // LUI
-		instr = implUtype(*insdword);
-		instr.mnemonic = InstrName::LUI;
-		return instr;
-	}
-	case 0b0010111: { // AUIPC
-		instr = implUtype(*insdword);
-		instr.mnemonic = InstrName::AUIPC;
-		return instr;
-	}
-	case 0b1101111: { // JAL
-		instr = implJtype(*insdword);
-		instr.mnemonic = InstrName::JAL;
-
-		// Check for pseudo-instruction J
-		if (instr.rd == Registers::Zero) {
-			instr.imm += addr;
-			instr.mnemonic = InstrName::J;
-		}
-		return instr;
+	case 0b0011011: // OP-IMM-32
+	case 0b0111011: // OP-32
+		return true;
+	case 0b0000011: // LOAD
+		return funct3 == 0b011 || funct3 == 0b110;
+	case 0b0100011: // STORE
+	case 0b0101111: // AMO
+		return funct3 == 0b011;
+	case 0b1010011: // OP-FP
+		if ((funct7 >> 2) == 0b11000 || (funct7 >> 2) == 0b11010)
+			return ((match >> 20) & 0b11111) >= 2;
+		// fmv.x.d and fmv.d.x, fclass.d shares the funct7 of fmv.x.d
+		return (funct7 == 0b1110001 && funct3 == 0b000) || funct7 == 0b1111001;
+	default:
+		return false;
 	}
-	case 0b1100111: { // JALR
-		instr = implItype(*insdword);
-		if (instr.rd == Registers::Zero && instr.rs1 == Registers::ra) {
-			instr.mnemonic = InstrName::RET;
-		} else if (instr.rd == Registers::Zero) {
-			instr.mnemonic = InstrName::JR;
-		} else {
-			instr.mnemonic = InstrName::JALR;
-		}
-		return instr;
+}
+
+constexpr InstrDesc instrTable[] = {
+#define INSTR(id, mnemonic, mask, match, format, operands, lift) \
+	{ mask, match, InstrName::id, InstrType::format, isRv64Only(match) },
+#include "instructions.def"
+#undef INSTR
+};
+
+constexpr size_t instrTableSize = sizeof(instrTable) / sizeof(instrTable[0]);
+
+// Every base format selects the instruction with the major opcode and funct3,
+// so those ten bits index the candidate list that is checked against the table
+constexpr size_t decodeKeyCount = 1 << 10;
+
+constexpr uint32_t decodeKey(uint32_t insword)
+{
+	return (insword & 0x7f) | ((insword >> 5) & 0x380);
+}
+
+constexpr bool inBucket(const InstrDesc& desc, uint32_t key)
+{
+	return (key & decodeKey(desc.mask)) == decodeKey(desc.match);
+}
+
+constexpr size_t decodeIndexSize()
+{
+	size_t count = 0;
+	for (uint32_t key = 0; key < decodeKeyCount; key++)
+		for (size_t i = 0; i < instrTableSize; i++)
+			if (inBucket(instrTable[i], key))
+				count++;
+	return count;
+}
+
+struct DecodeIndex {
+	uint16_t start[decodeKeyCount + 1] {};
+	uint16_t entries[decodeIndexSize()] {};
+};
+
+constexpr DecodeIndex buildDecodeIndex()
+{
+	DecodeIndex index {};
+	uint16_t next = 0;
+	for (uint32_t key = 0; key < decodeKeyCount; key++) {
+		index.start[key] = next;
+		for (size_t i = 0; i < instrTableSize; i++)
+			if (inBucket(instrTable[i], key))
+				index.entries[next++] = i;
 	}
-	case 0b1100011: { // Branch Instructions
-		instr = implBtype(*insdword);
+	index.start[decodeKeyCount] = next;
+	return index;
+}
 
-		switch (instr.funct3) {
-		case 0b000:
-			instr.mnemonic = InstrName::BEQ;
-			break;
-		case 0b001:
-			instr.mnemonic = InstrName::BNE;
-			break;
-		case 0b100:
-			instr.mnemonic = InstrName::BLT;
-			break;
-		case 0b101:
-			instr.mnemonic = InstrName::BGE;
-			break;
-		case 0b110:
-			instr.mnemonic = InstrName::BLTU;
-			break;
-		case 0b111:
-			instr.mnemonic = InstrName::BGEU;
-			break;
-		default:
-			BinaryNinja::Log(ErrorLog, "Unknown funct3 [%d] for Branch instr",
-				instr.funct3);
-			instr.type = InstrType::Error;
-			instr.mnemonic = InstrName::UNSUPPORTED;
-			break;
-		}
+constexpr DecodeIndex decodeIndex = buildDecodeIndex();
+}
 
+// Decodes the instruction of the given size at data and returns the parcel
+// or word it was decoded from in insword
+template <unsigned Xlen>
+static Instruction fetchAndDecode(const uint8_t* data, size_t size, uint32_t& insword)
+{
+	if (size == 2) {
+		const uint16_t parcel = Fetch::parcel(data);
+		const uint32_t expanded = Xlen == 32 ? Compressed::expand32(parcel) : Compressed::expand(parcel);
+		Instruction instr;
+		if (expanded != 0)
+			instr = Disassembler::decode<Xlen>(expanded);
+		instr.size = 2;
+		insword = parcel;
 		return instr;
 	}
-	case 0b0000011: { // Load Instructions
-		instr = implItype(*insdword);
 
-		switch (instr.funct3) {
-		case 0b000:
-			instr.mnemonic = InstrName::LB;
-			break;
-		case 0b001:
-			instr.mnemonic = InstrName::LH;
-			break;
-		case 0b010:
-			instr.mnemonic = InstrName::LW;
-			break;
-		case 0b011:
-			instr.mnemonic = InstrName::LD;
-			break;
-		case 0b100:
-			instr.mnemonic = InstrName::LBU;
-			break;
-		case 0b101:
-			instr.mnemonic = InstrName::LHU;
-			break;
-		case 0b110:
-			instr.mnemonic = InstrName::LWU;
-			break;
-		default:
-			BinaryNinja::Log(ErrorLog, "Unknown funct3 [%d] for Load instr",
-				instr.funct3);
-			instr.type = InstrType::Error;
-			instr.mnemonic = InstrName::UNSUPPORTED;
-			break;
-		}
+	insword = Fetch::word(data);
+	return Disassembler::decode<Xlen>(insword);
+}
+
+template <unsigned Xlen>
+Instruction Disassembler::disasm(const uint8_t* data, size_t len, uint64_t addr)
+{
+	RISCV_PROFILE_SCOPE(ProbeDisasm);
+	const size_t size = Fetch::length(data, len);
+	if (size == 0)
+		return Instruction {};
+
+	uint32_t insword;
+	const Instruction instr = fetchAndDecode<Xlen>(data, size, insword);
+	if (instr.type == InstrType::Error)
+		Diagnostics::recordUndecodable(addr, insword);
+	RISCV_PROFILE_DECODE(instr, insword);
+	return instr;
+}
+
+template <unsigned Xlen>
+Instruction Disassembler::decode(uint32_t insdword)
+{
+	static Instruction (*const extract[])(uint32_t) = {
+		implRtype, implItype, implStype, implBtype, implUtype, implJtype
+	};
 
+	const uint32_t key = decodeKey(insdword);
+	for (uint16_t i = decodeIndex.start[key]; i < decodeIndex.start[key + 1]; i++) {
+		const InstrDesc& desc = instrTable[decodeIndex.entries[i]];
+		if ((insdword & desc.mask) != desc.match)
+			continue;
+
+		Instruction instr = extract[desc.format](insdword);
+		instr.mnemonic = desc.name;
+		if (instrOperands[desc.name] == RdRs1Shamt)
+			instr.imm &= 0x3f;
+		// RV32 reserves the RV64 encodings and shift amounts of 32 and up
+		if (Xlen == 32 && (desc.rv64Only || (instrOperands[desc.name] == RdRs1Shamt && instr.imm >= 32)))
+			return Instruction {};
 		return instr;
 	}
-	case 0b0100011: { // Store Instructions
-		instr = implStype(*insdword);
 
-		switch (instr.funct3) {
-		case 0b000:
-			instr.mnemonic = InstrName::SB;
-			break;
-		case 0b001:
-			instr.mnemonic = InstrName::SH;
-			break;
-		case 0b010:
-			instr.mnemonic = InstrName::SW;
-			break;
-		case 0b011:
-			instr.mnemonic = InstrName::SD;
-			break;
-		default:
-			BinaryNinja::Log(ErrorLog, "Unknown funct3 [%d] for Store instr",
-				instr.funct3);
-			instr.type = InstrType::Error;
-			instr.mnemonic = InstrName::UNSUPPORTED;
-			break;
-		}
+	return Instruction {};
+}
+
+template Instruction Disassembler::disasm<32>(const uint8_t* data, size_t len, uint64_t addr);
+template Instruction Disassembler::disasm<64>(const uint8_t* data, size_t len, uint64_t addr);
+template Instruction Disassembler::decode<32>(uint32_t insword);
+template Instruction Disassembler::decode<64>(uint32_t insword);
+
+// Builds the same Instruction as decode() from one lane of extracted fields
+static Instruction decodeLane(const uint32_t insword, const FieldBlock& fields, size_t lane)
+{
+	Instruction instr;
+	if (fields.opClass[lane] == ClassInvalid || fields.opClass[lane] == ClassCompressed)
 		return instr;
-	}
-	case 0b0010011: { // Immediate Arithmetic
-		instr = implItype(*insdword);
-
-		switch (instr.funct3) {
-		case 0b000: { // Covers pseudo-instr load immediate - li
-			if (instr.rs1 == Registers::Zero)
-				instr.mnemonic = InstrName::LI;
-			else if (instr.imm == 0)
-				instr.mnemonic = InstrName::MV;
-			else
-				instr.mnemonic = InstrName::ADDI;
-			break;
-		}
-		case 0b010:
-			instr.mnemonic = InstrName::SLTI;
-			break;
-		case 0b011:
-			instr.mnemonic = InstrName::SLTIU;
-			break;
-		case 0b100:
-			instr.mnemonic = InstrName::XORI;
-			break;
-		case 0b110:
-			instr.mnemonic = InstrName::ORI;
-			break;
-		case 0b111:
-			instr.mnemonic = InstrName::ANDI;
-			break;
-		case 0b001:
-			instr.mnemonic = InstrName::SLLI;
-			break;
-		case 0b101: {
-			if ((instr.imm >> 30) == 0)
-				instr.mnemonic = InstrName::SRLI;
-			else
-				instr.mnemonic = InstrName::SRAI;
 
-			instr.imm = instr.imm & 0x3f;
+	const uint32_t key = fields.key[lane];
+	for (uint16_t i = decodeIndex.start[key]; i < decodeIndex.start[key + 1]; i++) {
+		const InstrDesc& desc = instrTable[decodeIndex.entries[i]];
+		if ((insword & desc.mask) != desc.match)
+			continue;
+
+		instr.type = desc.format;
+		instr.mnemonic = desc.name;
+		switch (desc.format) {
+		case Rtype:
+			instr.rd = fields.rd[lane];
+			instr.funct3 = fields.funct3[lane];
+			instr.rs1 = fields.rs1[lane];
+			instr.rs2 = fields.rs2[lane];
+			instr.funct7 = fields.funct7[lane];
+			break;
+		case Itype:
+			instr.rs1 = fields.rs1[lane];
+			instr.rd = fields.rd[lane];
+			instr.funct3 = fields.funct3[lane];
+			instr.imm = fields.immI[lane];
+			break;
+		case Stype:
+			instr.imm = fields.immS[lane];
+			instr.rs2 = fields.rs2[lane];
+			instr.rs1 = fields.rs1[lane];
+			instr.funct3 = fields.funct3[lane];
+			break;
+		case Btype:
+			instr.imm = fields.immB[lane];
+			instr.rs2 = fields.rs2[lane];
+			instr.rs1 = fields.rs1[lane];
+			instr.funct3 = fields.funct3[lane];
+			break;
+		case Utype:
+			instr.rd = fields.rd[lane];
+			instr.imm = fields.immU[lane];
+			break;
+		case Jtype:
+			instr.imm = fields.immJ[lane];
+			instr.rd = fields.rd[lane];
 			break;
-		}
 		default:
-			BinaryNinja::Log(ErrorLog,
-				"Unknown funct3 [%d] for Immediate Arithmetic instr",
-				instr.funct3);
-			instr.type = InstrType::Error;
-			instr.mnemonic = InstrName::UNSUPPORTED;
 			break;
 		}
+		if (instrOperands[desc.name] == RdRs1Shamt)
+			instr.imm &= 0x3f;
 		return instr;
 	}
-	case 0b0110011: { // Register Arithmetic - 64bit
-		instr = implRtype(*insdword);
-		switch (instr.funct3) {
-		case 0b000: {
-			if (instr.funct7 == 0)
-				instr.mnemonic = InstrName::ADD;
-			else
-				instr.mnemonic = InstrName::SUB;
-			break;
-		}
-		case 0b001:
-			instr.mnemonic = InstrName::SLL;
-			break;
-		case 0b010:
-			instr.mnemonic = InstrName::SLT;
-			break;
-		case 0b011:
-			instr.mnemonic = InstrName::SLTU;
-			break;
-		case 0b100:
-			instr.mnemonic = InstrName::XOR;
-			break;
-		case 0b101: {
-			if (instr.funct7 == 0)
-				instr.mnemonic = InstrName::SRL;
-			else
-				instr.mnemonic = InstrName::SRA;
-			break;
-		}
-		case 0b110:
-			instr.mnemonic = InstrName::OR;
-			break;
-		case 0b111:
-			instr.mnemonic = InstrName::AND;
-			break;
-		default:
-			BinaryNinja::Log(ErrorLog,
-				"Unknown funct3 [%d] for Register Arithmetic instr",
-				instr.funct3);
-			instr.type = InstrType::Error;
-			instr.mnemonic = InstrName::UNSUPPORTED;
-			break;
-		}
-		return instr;
+
+	return instr;
+}
+
+void Disassembler::decodeWords(const uint32_t* words, size_t count, Instruction* out)
+{
+	FieldBlock fields;
+	size_t i = 0;
+	for (; i + FieldBlock::Width <= count; i += FieldBlock::Width) {
+		FieldExtract::extract(words + i, fields);
+		for (size_t lane = 0; lane < FieldBlock::Width; lane++)
+			out[i + lane] = decodeLane(words[i + lane], fields, lane);
 	}
-	case 0b0111011: {
-		instr = implRtype(*insdword);
-		switch (instr.funct3) {
-		case 0b000: {
-			if (instr.funct7 == 0)
-				instr.mnemonic = InstrName::ADDW;
-			else
-				instr.mnemonic = InstrName::SUBW;
-			break;
-		}
-		case 0b001:
-			instr.mnemonic = InstrName::SLLW;
-			break;
-		case 0b101: {
-			if (instr.funct7 == 0)
-				instr.mnemonic = InstrName::SRLW;
-			else
-				instr.mnemonic = InstrName::SRAW;
+
+	for (; i < count; i++)
+		out[i] = decode(words[i]);
+}
+
+template <unsigned Xlen>
+size_t Disassembler::decodeRange(const uint8_t* data, size_t len,
+	Instruction* out, size_t maxCount)
+{
+	size_t count = 0;
+	size_t offset = 0;
+	size_t size;
+	while (count < maxCount && (size = Fetch::length(data + offset, len - offset)) != 0) {
+		// The word that ends the range is left for the caller to decode, so
+		// its diagnostics are not recorded here
+		uint32_t insword;
+		const Instruction instr = fetchAndDecode<Xlen>(data + offset, size, insword);
+		if (instr.type == InstrType::Error)
 			break;
-		}
-		default:
-			BinaryNinja::Log(ErrorLog,
-				"Unknown funct3 [%d] for Register Arithmetic instr",
-				instr.funct3);
-			instr.type = InstrType::Error;
-			instr.mnemonic = InstrName::UNSUPPORTED;
+
+		out[count++] = instr;
+		offset += instr.size;
+		if (isControlFlow(instr.mnemonic))
 			break;
-		}
-		return instr;
 	}
-	case 0b1110011: { // ECALL or EBREAK
-		instr = implItype(*insdword);
-		if (instr.imm != 0)
-			instr.mnemonic = InstrName::EBREAK;
-		else
-			instr.mnemonic = InstrName::ECALL;
-		return instr;
+	return count;
+}
+
+template size_t Disassembler::decodeRange<32>(const uint8_t* data, size_t len,
+	Instruction* out, size_t maxCount);
+template size_t Disassembler::decodeRange<64>(const uint8_t* data, size_t len,
+	Instruction* out, size_t maxCount);
+
+bool Disassembler::isControlFlow(InstrName mnemonic)
+{
+	switch (mnemonic) {
+	case InstrName::J:
+	case InstrName::JAL:
+	case InstrName::RET:
+	case InstrName::JR:
+	case InstrName::JALR:
+	case InstrName::BEQ:
+	case InstrName::BNE:
+	case InstrName::BLT:
+	case InstrName::BGE:
+	case InstrName::BLTU:
+	case InstrName::BGEU:
+	case InstrName::ECALL:
+	case InstrName::EBREAK:
+	case InstrName::SRET:
+	case InstrName::MRET:
+		return true;
+	default:
+		return false;
 	}
-	case 0b0011011:
-		instr = implRtype(*insdword);
-		switch (instr.funct3) {
-		case 0b000: {
-			instr = implItype(*insdword);
-			instr.mnemonic = InstrName::ADDIW;
-			break;
-		}
-		case 0b001:
-			instr.mnemonic = InstrName::SLLIW;
-			break;
-		case 0b101: {
-			if (instr.funct7 == 0)
-				instr.mnemonic = InstrName::SRLIW;
-			else
-				instr.mnemonic = InstrName::SRAIW;
-			break;
-		}
-		default:
-			BinaryNinja::Log(
-				ErrorLog, "Unknown funct3 [%d] for Word Immediate Arithmetic instr",
-				instr.funct3);
-			instr.type = InstrType::Error;
-			instr.mnemonic = InstrName::UNSUPPORTED;
-			break;
-		}
-		return instr;
-	case 0b1111:
-		instr = implItype(*insdword);
-		instr.mnemonic = InstrName::FENCE;
-		return instr;
+}
+
+FlowKind Disassembler::flowKind(const Instruction& instr)
+{
+	switch (instr.mnemonic) {
+	case InstrName::BEQ:
+	case InstrName::BNE:
+	case InstrName::BLT:
+	case InstrName::BGE:
+	case InstrName::BLTU:
+	case InstrName::BGEU:
+		return FlowConditionalBranch;
+	case InstrName::J:
+		return FlowJump;
+	case InstrName::JAL:
+		return isLinkRegister(instr.rd) ? FlowCall : FlowJump;
+	case InstrName::RET:
+	// Trap returns go back to the address in sepc or mepc
+	case InstrName::SRET:
+	case InstrName::MRET:
+		return FlowReturn;
+	case InstrName::JR:
+	case InstrName::JALR:
+		// Writing a link register pushes the return address stack, so that is a
+		// call even when rs1 is a link register too. Otherwise reading one pops
+		// it, which is a return.
+		if (isLinkRegister(instr.rd))
+			return FlowIndirectCall;
+		if (isLinkRegister(instr.rs1))
+			return FlowReturn;
+		return FlowIndirectJump;
 	default:
-		BinaryNinja::Log(ErrorLog,
-			"Unimplemented instr - Addr: 0x%llx, Opcode: 0x%x\n", addr,
-			opcode);
-		instr.type = InstrType::Error;
-		instr.mnemonic = InstrName::UNSUPPORTED;
-		return instr;
+		return FlowNone;
 	}
 }
 
@@ -5,8 +5,6 @@
 #include <cstdlib>
 #include <string>
 
-#include "binaryninjaapi.h"
-
 enum Registers {
 	Zero = 0,
 	// x1 - return address (caller saved)
@@ -53,89 +51,100 @@ enum Registers {
 	t6,
 	// pc (caller saved)
 	pc,
+	// f0-7 - FP temporaries (caller saved)
+	ft0,
+	ft1,
+	ft2,
+	ft3,
+	ft4,
+	ft5,
+	ft6,
+	ft7,
+	// f8-9 - FP saved registers (callee saved)
+	fs0,
+	fs1,
+	// f10-11 - FP arguments and return values (caller saved)
+	fa0,
+	fa1,
+	// f12-17 - FP arguments (caller saved)
+	fa2,
+	fa3,
+	fa4,
+	fa5,
+	fa6,
+	fa7,
+	// f18-27 - FP saved registers (callee saved)
+	fs2,
+	fs3,
+	fs4,
+	fs5,
+	fs6,
+	fs7,
+	fs8,
+	fs9,
+	fs10,
+	fs11,
+	// f28-31 - FP temporaries (caller saved)
+	ft8,
+	ft9,
+	ft10,
+	ft11,
+	// FP control and status register
+	fcsr,
 };
 
-static const char* registerNames[] = {
+// Register number of the FP register with the given 5-bit encoding
+inline uint32_t fpRegister(uint32_t encoding)
+{
+	return Registers::ft0 + encoding;
+}
+
+// Address offset bytes from addr, which wraps at 32 bits on RV32
+template <unsigned Xlen>
+inline uint64_t targetAddr(uint64_t addr, int64_t offset)
+{
+	const uint64_t target = addr + offset;
+	return Xlen == 32 ? (uint32_t)target : target;
+}
+
+inline constexpr const char* registerNames[] = {
 	"zero", "ra", "sp", "gp", "tp", "t0", "t1", "t2", "s0", "s1", "a0",
 	"a1", "a2", "a3", "a4", "a5", "a6", "a7", "s2", "s3", "s4", "s5",
-	"s6", "s7", "s8", "s9", "s10", "s11", "t3", "t4", "t5", "t6", "pc"
+	"s6", "s7", "s8", "s9", "s10", "s11", "t3", "t4", "t5", "t6", "pc",
+	"ft0", "ft1", "ft2", "ft3", "ft4", "ft5", "ft6", "ft7", "fs0", "fs1", "fa0",
+	"fa1", "fa2", "fa3", "fa4", "fa5", "fa6", "fa7", "fs2", "fs3", "fs4", "fs5",
+	"fs6", "fs7", "fs8", "fs9", "fs10", "fs11", "ft8", "ft9", "ft10", "ft11", "fcsr"
 };
 
-static const char* instrNames[] = {
-	"lui", "auipc", "jal", "jalr", "beq", "bne", "blt", "bge",
-	"bltu", "bgeu", "lb", "lh", "lw", "lbu", "lhu", "sb",
-	"sh", "sw", "addi", "slti", "sltiu", "xori", "ori", "andi",
-	"slli", "srli", "add", "sub", "sll", "slt", "sltu", "xor",
-	"srl", "sra", "or", "and", "fence", "ecall", "ebreak", "lwu",
-	"ld", "sd", "srai", "addiw", "slliw", "srliw", "sraiw", "addw",
-	"subw", "sllw", "srlw", "sraw", "j", "li", "ret", "mv", "jr"
+enum InstrName : int16_t {
+	UNSUPPORTED = -1,
+#define INSTR(id, mnemonic, mask, match, format, operands, lift) id,
+#include "instructions.def"
+#undef INSTR
+	INSTR_COUNT
 };
 
-enum InstrName {
-	UNSUPPORTED = -1,
-	// RV32I Base
-	LUI = 0,
-	AUIPC,
-	JAL,
-	JALR,
-	BEQ,
-	BNE,
-	BLT,
-	BGE,
-	BLTU,
-	BGEU,
-	LB,
-	LH,
-	LW,
-	LBU,
-	LHU,
-	SB,
-	SH,
-	SW,
-	ADDI,
-	SLTI,
-	SLTIU,
-	XORI,
-	ORI,
-	ANDI,
-	SLLI,
-	SRLI,
-	ADD,
-	SUB,
-	SLL,
-	SLT,
-	SLTU,
-	XOR,
-	SRL,
-	SRA,
-	OR,
-	AND,
-	FENCE,
-	ECALL,
-	EBREAK,
-	// RV64I Base
-	LWU,
-	LD,
-	SD,
-	SRAI,
-	ADDIW,
-	SLLIW,
-	SRLIW,
-	SRAIW,
-	ADDW,
-	SUBW,
-	SLLW,
-	SRLW,
-	SRAW,
-	// Pseudo-instructions for RV64I
-	J,
-	LI,
-	RET,
-	MV,
-	JR
+inline constexpr const char* instrNames[] = {
+#define INSTR(id, mnemonic, mask, match, format, operands, lift) mnemonic,
+#include "instructions.def"
+#undef INSTR
 };
 
-enum InstrType {
+// How an instruction transfers control. Jumps through registers are told
+// apart with the return-address stack hints of the RISC-V spec, where x1 (ra)
+// and x5 (t0) are link registers.
+enum FlowKind : uint8_t {
+	FlowNone,
+	FlowConditionalBranch,
+	FlowJump,
+	FlowCall,
+	FlowIndirectCall,
+	FlowReturn,
+	// Indirect jump or tail call, including jump table dispatch
+	FlowIndirectJump
+};
+
+enum InstrType : int8_t {
 	Error = -1,
 	Rtype,
 	Itype,
@@ -145,18 +154,87 @@ enum InstrType {
 	Jtype
 };
 
+// Operand layout of an instruction, used by the text printer
+enum OperandKind {
+	NoOperands,
+	RdRs1Rs2,
+	RdRs1Imm,
+	RdRs1Shamt,
+	RdRs1,
+	RdImm,
+	RdMem,
+	Rs2Mem,
+	Rs1Rs2Target,
+	RdTarget,
+	Target,
+	Rs1,
+	// Operands starting with F are FP registers
+	FdFs1Fs2,
+	FdFs1Fs2Fs3,
+	FdFs1,
+	FdRs1,
+	RdFs1,
+	RdFs1Fs2,
+	FdMem,
+	Fs2Mem,
+	// Atomics, the address is printed as (rs1)
+	RdAddr,
+	RdRs2Addr,
+	// CSR accesses, Uimm is the 5-bit immediate in the rs1 field
+	RdCsr,
+	CsrRs1,
+	CsrUimm,
+	RdCsrRs1,
+	RdCsrUimm,
+	Rs1Rs2
+};
+
+static const OperandKind instrOperands[] = {
+#define INSTR(id, mnemonic, mask, match, format, operands, lift) operands,
+#include "instructions.def"
+#undef INSTR
+};
+
+// Decoded instructions are cached and passed around by value, so the fields
+// are packed into 12 bytes. Registers are kept as their 5-bit encodings. For
+// the R4-type FP instructions rs3 and the format are in funct7, see rs3().
 class Instruction {
 public:
-	InstrType type = Error;
-	InstrName mnemonic = InstrName::UNSUPPORTED;
-	size_t rd = 0;
-	size_t rs1 = 0;
-	size_t rs2 = 0;
-	uint32_t funct7 = 0;
-	uint32_t funct3 = 0;
-	int64_t imm = 0;
+	int32_t imm;
+	InstrName mnemonic;
+	InstrType type;
+	// Length in bytes, 2 for RVC instructions
+	uint8_t size;
+	uint32_t rd : 5;
+	uint32_t rs1 : 5;
+	uint32_t rs2 : 5;
+	uint32_t funct3 : 3;
+	uint32_t funct7 : 7;
+
+	Instruction()
+		: imm(0)
+		, mnemonic(InstrName::UNSUPPORTED)
+		, type(InstrType::Error)
+		, size(4)
+		, rd(0)
+		, rs1(0)
+		, rs2(0)
+		, funct3(0)
+		, funct7(0)
+	{
+	}
+
+	uint32_t rs3() const { return funct7 >> 2; }
+
+	// CSR number of a Zicsr instruction
+	uint32_t csr() const { return (uint32_t)imm & 0xfff; }
+
+	// Memory ordering bits of an atomic, aq in bit 1 and rl in bit 0
+	uint32_t ordering() const { return funct7 & 0b11; }
 };
 
+static_assert(sizeof(Instruction) == 12, "Instruction should stay packed");
+
 class Disassembler {
 	static Instruction implRtype(uint32_t insword);
 
@@ -171,7 +249,38 @@ class Disassembler {
 	static Instruction implJtype(uint32_t insword);
 
 public:
-	static Instruction disasm(const uint8_t* data, uint64_t addr);
+	// Decodes the instruction at data, reading no more than len bytes. A
+	// truncated instruction decodes as an error. Xlen selects RV32 or RV64.
+	// RV32 rejects the RV64-only encodings and expands compressed instructions
+	// with the RV32C meanings.
+	template <unsigned Xlen = 64>
+	static Instruction disasm(const uint8_t* data, size_t len, uint64_t addr);
+
+	// Decodes a 32-bit instruction word, compressed instructions must be expanded first
+	template <unsigned Xlen = 64>
+	static Instruction decode(uint32_t insword);
+
+	// Decodes consecutive instructions starting at data into out. Decoding stops
+	// after the first control-flow instruction, before an undecodable or
+	// truncated instruction, or once maxCount instructions have been decoded.
+	// Returns the number of instructions written to out. Nothing is recorded
+	// in Diagnostics or the profiler.
+	template <unsigned Xlen = 64>
+	static size_t decodeRange(const uint8_t* data, size_t len,
+		Instruction* out, size_t maxCount);
+
+	// Decodes count 32-bit instruction words using the vectorized field
+	// extractor. Words that start a compressed instruction decode as errors
+	// since the stream is assumed to hold only 32-bit instructions.
+	static void decodeWords(const uint32_t* words, size_t count, Instruction* out);
+
+	// True for instructions that can transfer control somewhere other than the
+	// next instruction
+	static bool isControlFlow(InstrName mnemonic);
+
+	static FlowKind flowKind(const Instruction& instr);
+
+	static bool isLinkRegister(uint32_t reg) { return reg == Registers::ra || reg == Registers::t0; }
 };
 
 #endif // BN_RISCV_ARCH_DISASSEMBLER_H
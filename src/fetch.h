@@ -0,0 +1,47 @@
+#ifndef BN_RISCV_ARCH_FETCH_H
+#define BN_RISCV_ARCH_FETCH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "compressed.h"
+
+// Reads instruction parcels out of a byte buffer. Instructions are only
+// 2-byte aligned and may sit at the very end of a segment, so every read
+// goes through memcpy, which compiles to a single unaligned load, and
+// nothing is read past the available length. Parcels are little-endian
+// regardless of the data byte order.
+class Fetch {
+public:
+	static uint16_t parcel(const uint8_t* data)
+	{
+		uint16_t value;
+		memcpy(&value, data, sizeof(value));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+		value = __builtin_bswap16(value);
+#endif
+		return value;
+	}
+
+	static uint32_t word(const uint8_t* data)
+	{
+		uint32_t value;
+		memcpy(&value, data, sizeof(value));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+		value = __builtin_bswap32(value);
+#endif
+		return value;
+	}
+
+	// Length of the instruction at data, or 0 if it does not fit in len bytes
+	static size_t length(const uint8_t* data, size_t len)
+	{
+		if (len < 2)
+			return 0;
+		const size_t size = Compressed::isCompressed(parcel(data)) ? 2 : 4;
+		return size <= len ? size : 0;
+	}
+};
+
+#endif // BN_RISCV_ARCH_FETCH_H
@@ -0,0 +1,220 @@
+#include "fieldExtract.h"
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define RISCV_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+// MSVC allows intrinsics for any instruction set without per-function flags
+#define RISCV_TARGET(isa)
+#else
+#define RISCV_TARGET(isa) __attribute__((target(isa)))
+#endif
+#endif
+
+static constexpr uint8_t classTable[32] = {
+	ClassLoad, ClassLoadFp, ClassInvalid, ClassMiscMem,
+	ClassOpImm, ClassAuipc, ClassOpImm32, ClassInvalid,
+	ClassStore, ClassStoreFp, ClassInvalid, ClassAmo,
+	ClassOp, ClassLui, ClassOp32, ClassInvalid,
+	ClassFma, ClassFma, ClassFma, ClassFma,
+	ClassOpFp, ClassInvalid, ClassInvalid, ClassInvalid,
+	ClassBranch, ClassJalr, ClassInvalid, ClassJal,
+	ClassSystem, ClassInvalid, ClassInvalid, ClassInvalid
+};
+
+void FieldExtract::extractScalar(const uint32_t* words, FieldBlock& out)
+{
+	for (size_t i = 0; i < FieldBlock::Width; i++) {
+		const uint32_t w = words[i];
+		out.opcode[i] = w & 0x7f;
+		out.rd[i] = (w >> 7) & 0x1f;
+		out.funct3[i] = (w >> 12) & 0x7;
+		out.rs1[i] = (w >> 15) & 0x1f;
+		out.rs2[i] = (w >> 20) & 0x1f;
+		out.funct7[i] = w >> 25;
+		out.immI[i] = (int32_t)w >> 20;
+		out.immS[i] = ((int32_t)(w & 0xfe000000) >> 20) | ((w >> 7) & 0x1f);
+		out.immB[i] = ((int32_t)(w & 0x80000000) >> 19) | ((w & 0x80) << 4)
+			| ((w >> 20) & 0x7e0) | ((w >> 7) & 0x1e);
+		out.immU[i] = w >> 12;
+		out.immJ[i] = ((int32_t)(w & 0x80000000) >> 11) | (w & 0xff000)
+			| ((w >> 9) & 0x800) | ((w >> 20) & 0x7fe);
+		out.key[i] = (w & 0x7f) | ((w >> 5) & 0x380);
+		out.opClass[i] = (w & 0b11) != 0b11 ? (uint32_t)ClassCompressed : (uint32_t)classTable[(w >> 2) & 0x1f];
+	}
+}
+
+#ifdef RISCV_X86
+RISCV_TARGET("sse4.2")
+static void extractSse42(const uint32_t* words, FieldBlock& out)
+{
+	const __m128i lutLo = _mm_loadu_si128((const __m128i*)classTable);
+	const __m128i lutHi = _mm_loadu_si128((const __m128i*)(classTable + 16));
+	const __m128i mask5 = _mm_set1_epi32(0x1f);
+	const __m128i three = _mm_set1_epi32(0b11);
+	const __m128i signBit = _mm_set1_epi32((int)0x80000000);
+
+	for (size_t i = 0; i < FieldBlock::Width; i += 4) {
+		const __m128i w = _mm_loadu_si128((const __m128i*)(words + i));
+
+		_mm_storeu_si128((__m128i*)(out.opcode + i), _mm_and_si128(w, _mm_set1_epi32(0x7f)));
+		_mm_storeu_si128((__m128i*)(out.rd + i), _mm_and_si128(_mm_srli_epi32(w, 7), mask5));
+		_mm_storeu_si128((__m128i*)(out.funct3 + i), _mm_and_si128(_mm_srli_epi32(w, 12), _mm_set1_epi32(0x7)));
+		_mm_storeu_si128((__m128i*)(out.rs1 + i), _mm_and_si128(_mm_srli_epi32(w, 15), mask5));
+		_mm_storeu_si128((__m128i*)(out.rs2 + i), _mm_and_si128(_mm_srli_epi32(w, 20), mask5));
+		_mm_storeu_si128((__m128i*)(out.funct7 + i), _mm_srli_epi32(w, 25));
+
+		_mm_storeu_si128((__m128i*)(out.immI + i), _mm_srai_epi32(w, 20));
+
+		const __m128i immS = _mm_or_si128(
+			_mm_srai_epi32(_mm_and_si128(w, _mm_set1_epi32((int)0xfe000000)), 20),
+			_mm_and_si128(_mm_srli_epi32(w, 7), mask5));
+		_mm_storeu_si128((__m128i*)(out.immS + i), immS);
+
+		const __m128i sign = _mm_and_si128(w, signBit);
+		const __m128i immB = _mm_or_si128(
+			_mm_or_si128(_mm_srai_epi32(sign, 19), _mm_slli_epi32(_mm_and_si128(w, _mm_set1_epi32(0x80)), 4)),
+			_mm_or_si128(_mm_and_si128(_mm_srli_epi32(w, 20), _mm_set1_epi32(0x7e0)),
+				_mm_and_si128(_mm_srli_epi32(w, 7), _mm_set1_epi32(0x1e))));
+		_mm_storeu_si128((__m128i*)(out.immB + i), immB);
+
+		_mm_storeu_si128((__m128i*)(out.immU + i), _mm_srli_epi32(w, 12));
+
+		const __m128i immJ = _mm_or_si128(
+			_mm_or_si128(_mm_srai_epi32(sign, 11), _mm_and_si128(w, _mm_set1_epi32(0xff000))),
+			_mm_or_si128(_mm_and_si128(_mm_srli_epi32(w, 9), _mm_set1_epi32(0x800)),
+				_mm_and_si128(_mm_srli_epi32(w, 20), _mm_set1_epi32(0x7fe))));
+		_mm_storeu_si128((__m128i*)(out.immJ + i), immJ);
+
+		_mm_storeu_si128((__m128i*)(out.key + i),
+			_mm_or_si128(_mm_and_si128(w, _mm_set1_epi32(0x7f)),
+				_mm_and_si128(_mm_srli_epi32(w, 5), _mm_set1_epi32(0x380))));
+
+		// Look the class up 16 entries at a time, the upper bytes of each lane
+		// index with the high bit set so the shuffle zeroes them
+		const __m128i index = _mm_and_si128(_mm_srli_epi32(w, 2), mask5);
+		const __m128i shuffle = _mm_or_si128(_mm_and_si128(index, _mm_set1_epi32(0xf)),
+			_mm_set1_epi32((int)0x80808000));
+		const __m128i upperHalf = _mm_cmpgt_epi32(index, _mm_set1_epi32(15));
+		__m128i opClass = _mm_blendv_epi8(_mm_shuffle_epi8(lutLo, shuffle),
+			_mm_shuffle_epi8(lutHi, shuffle), upperHalf);
+		const __m128i full = _mm_cmpeq_epi32(_mm_and_si128(w, three), three);
+		opClass = _mm_blendv_epi8(_mm_set1_epi32(ClassCompressed), opClass, full);
+		_mm_storeu_si128((__m128i*)(out.opClass + i), opClass);
+	}
+}
+
+RISCV_TARGET("avx2")
+static void extractAvx2(const uint32_t* words, FieldBlock& out)
+{
+	const __m256i lutLo = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)classTable));
+	const __m256i lutHi = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)(classTable + 16)));
+	const __m256i mask5 = _mm256_set1_epi32(0x1f);
+	const __m256i three = _mm256_set1_epi32(0b11);
+
+	const __m256i w = _mm256_loadu_si256((const __m256i*)words);
+
+	_mm256_storeu_si256((__m256i*)out.opcode, _mm256_and_si256(w, _mm256_set1_epi32(0x7f)));
+	_mm256_storeu_si256((__m256i*)out.rd, _mm256_and_si256(_mm256_srli_epi32(w, 7), mask5));
+	_mm256_storeu_si256((__m256i*)out.funct3, _mm256_and_si256(_mm256_srli_epi32(w, 12), _mm256_set1_epi32(0x7)));
+	_mm256_storeu_si256((__m256i*)out.rs1, _mm256_and_si256(_mm256_srli_epi32(w, 15), mask5));
+	_mm256_storeu_si256((__m256i*)out.rs2, _mm256_and_si256(_mm256_srli_epi32(w, 20), mask5));
+	_mm256_storeu_si256((__m256i*)out.funct7, _mm256_srli_epi32(w, 25));
+
+	_mm256_storeu_si256((__m256i*)out.immI, _mm256_srai_epi32(w, 20));
+
+	const __m256i immS = _mm256_or_si256(
+		_mm256_srai_epi32(_mm256_and_si256(w, _mm256_set1_epi32((int)0xfe000000)), 20),
+		_mm256_and_si256(_mm256_srli_epi32(w, 7), mask5));
+	_mm256_storeu_si256((__m256i*)out.immS, immS);
+
+	const __m256i sign = _mm256_and_si256(w, _mm256_set1_epi32((int)0x80000000));
+	const __m256i immB = _mm256_or_si256(
+		_mm256_or_si256(_mm256_srai_epi32(sign, 19), _mm256_slli_epi32(_mm256_and_si256(w, _mm256_set1_epi32(0x80)), 4)),
+		_mm256_or_si256(_mm256_and_si256(_mm256_srli_epi32(w, 20), _mm256_set1_epi32(0x7e0)),
+			_mm256_and_si256(_mm256_srli_epi32(w, 7), _mm256_set1_epi32(0x1e))));
+	_mm256_storeu_si256((__m256i*)out.immB, immB);
+
+	_mm256_storeu_si256((__m256i*)out.immU, _mm256_srli_epi32(w, 12));
+
+	const __m256i immJ = _mm256_or_si256(
+		_mm256_or_si256(_mm256_srai_epi32(sign, 11), _mm256_and_si256(w, _mm256_set1_epi32(0xff000))),
+		_mm256_or_si256(_mm256_and_si256(_mm256_srli_epi32(w, 9), _mm256_set1_epi32(0x800)),
+			_mm256_and_si256(_mm256_srli_epi32(w, 20), _mm256_set1_epi32(0x7fe))));
+	_mm256_storeu_si256((__m256i*)out.immJ, immJ);
+
+	_mm256_storeu_si256((__m256i*)out.key,
+		_mm256_or_si256(_mm256_and_si256(w, _mm256_set1_epi32(0x7f)),
+			_mm256_and_si256(_mm256_srli_epi32(w, 5), _mm256_set1_epi32(0x380))));
+
+	const __m256i index = _mm256_and_si256(_mm256_srli_epi32(w, 2), mask5);
+	const __m256i shuffle = _mm256_or_si256(_mm256_and_si256(index, _mm256_set1_epi32(0xf)),
+		_mm256_set1_epi32((int)0x80808000));
+	const __m256i upperHalf = _mm256_cmpgt_epi32(index, _mm256_set1_epi32(15));
+	__m256i opClass = _mm256_blendv_epi8(_mm256_shuffle_epi8(lutLo, shuffle),
+		_mm256_shuffle_epi8(lutHi, shuffle), upperHalf);
+	const __m256i full = _mm256_cmpeq_epi32(_mm256_and_si256(w, three), three);
+	opClass = _mm256_blendv_epi8(_mm256_set1_epi32(ClassCompressed), opClass, full);
+	_mm256_storeu_si256((__m256i*)out.opClass, opClass);
+}
+
+static bool cpuSupports(FieldExtract::Kernel kernel)
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+	int info[4];
+	__cpuid(info, 1);
+	const bool sse42 = (info[2] & (1 << 20)) != 0;
+	const bool osxsave = (info[2] & (1 << 27)) != 0;
+	if (kernel == FieldExtract::Sse42)
+		return sse42;
+	if (!osxsave || (_xgetbv(0) & 0x6) != 0x6)
+		return false;
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+#else
+	if (kernel == FieldExtract::Sse42)
+		return __builtin_cpu_supports("sse4.2");
+	return __builtin_cpu_supports("avx2");
+#endif
+}
+#endif
+
+bool FieldExtract::supported(Kernel kernel)
+{
+	if (kernel == Scalar)
+		return true;
+#ifdef RISCV_X86
+	return cpuSupports(kernel);
+#else
+	return false;
+#endif
+}
+
+FieldExtract::Kernel FieldExtract::kernel()
+{
+	static const Kernel best = supported(Avx2) ? Avx2 : supported(Sse42) ? Sse42 : Scalar;
+	return best;
+}
+
+void FieldExtract::extractWith(Kernel kernel, const uint32_t* words, FieldBlock& out)
+{
+	switch (kernel) {
+#ifdef RISCV_X86
+	case Avx2:
+		extractAvx2(words, out);
+		return;
+	case Sse42:
+		extractSse42(words, out);
+		return;
+#endif
+	default:
+		extractScalar(words, out);
+		return;
+	}
+}
+
+void FieldExtract::extract(const uint32_t* words, FieldBlock& out)
+{
+	extractWith(kernel(), words, out);
+}
@@ -0,0 +1,78 @@
+#ifndef BN_RISCV_ARCH_FIELDEXTRACT_H
+#define BN_RISCV_ARCH_FIELDEXTRACT_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Major opcode groups, from bits [6:2] of a 32-bit instruction word
+enum OpClass : uint8_t {
+	ClassInvalid = 0,
+	ClassLoad,
+	ClassLoadFp,
+	ClassMiscMem,
+	ClassOpImm,
+	ClassAuipc,
+	ClassOpImm32,
+	ClassStore,
+	ClassStoreFp,
+	ClassAmo,
+	ClassOp,
+	ClassLui,
+	ClassOp32,
+	ClassFma,
+	ClassOpFp,
+	ClassBranch,
+	ClassJalr,
+	ClassJal,
+	ClassSystem,
+	// The word is the start of a 16-bit compressed instruction
+	ClassCompressed
+};
+
+// Every field and immediate of a group of instruction words, one array
+// element per word. The immediates are sign-extended exactly as the
+// Disassembler::impl*type helpers do.
+struct FieldBlock {
+	static constexpr size_t Width = 8;
+
+	uint32_t opcode[Width];
+	uint32_t rd[Width];
+	uint32_t funct3[Width];
+	uint32_t rs1[Width];
+	uint32_t rs2[Width];
+	uint32_t funct7[Width];
+	int32_t immI[Width];
+	int32_t immS[Width];
+	int32_t immB[Width];
+	int32_t immU[Width];
+	int32_t immJ[Width];
+	// Opcode and funct3, the key the decoder indexes its table with
+	uint32_t key[Width];
+	uint32_t opClass[Width];
+};
+
+// Splits FieldBlock::Width instruction words into their fields. The AVX2 and
+// SSE4.2 kernels are picked at runtime when the CPU supports them, and the
+// scalar kernel is the reference they must match bit for bit.
+class FieldExtract {
+public:
+	enum Kernel {
+		Scalar,
+		Sse42,
+		Avx2
+	};
+
+	static void extract(const uint32_t* words, FieldBlock& out);
+
+	static void extractScalar(const uint32_t* words, FieldBlock& out);
+
+	// Kernel used by extract() on this machine
+	static Kernel kernel();
+
+	static bool supported(Kernel kernel);
+
+	// Runs a specific kernel, which must be supported on this machine
+	static void extractWith(Kernel kernel, const uint32_t* words, FieldBlock& out);
+};
+
+#endif // BN_RISCV_ARCH_FIELDEXTRACT_H
@@ -0,0 +1,309 @@
+#include "formatter.h"
+#include "csr.h"
+
+#include <charconv>
+#include <cstdio>
+#include <cstring>
+
+#define PADDING_SIZE 6
+
+namespace {
+struct InternedString {
+	const char* text;
+	uint8_t length;
+};
+
+bool isAtomic(InstrName name)
+{
+	return instrOperands[name] == RdAddr || instrOperands[name] == RdRs2Addr;
+}
+
+// Lengths of the register and mnemonic strings and the padding that aligns
+// the operands after each mnemonic, computed once at load. Mnemonics are
+// indexed by the aq/rl ordering bits, which atomics print as a suffix.
+struct InternedStrings {
+	static constexpr size_t MaxMnemonic = 24;
+
+	InternedString registers[sizeof(registerNames) / sizeof(registerNames[0])];
+	InternedString mnemonics[INSTR_COUNT][4];
+	InternedString padding[INSTR_COUNT][4];
+	char orderedMnemonics[INSTR_COUNT][4][MaxMnemonic];
+
+	InternedStrings()
+	{
+		static const char spaces[PADDING_SIZE + 1] = "      ";
+		static const char* const suffixes[4] = { "", ".rl", ".aq", ".aqrl" };
+		for (size_t i = 0; i < sizeof(registerNames) / sizeof(registerNames[0]); i++)
+			registers[i] = { registerNames[i], (uint8_t)strlen(registerNames[i]) };
+		for (size_t i = 0; i < INSTR_COUNT; i++) {
+			for (size_t ordering = 0; ordering < 4; ordering++) {
+				const char* suffix = isAtomic((InstrName)i) ? suffixes[ordering] : "";
+				char* text = orderedMnemonics[i][ordering];
+				snprintf(text, MaxMnemonic, "%s%s", instrNames[i], suffix);
+				const size_t length = strlen(text);
+				mnemonics[i][ordering] = { text, (uint8_t)length };
+				const size_t pad = length < PADDING_SIZE ? PADDING_SIZE - length : 0;
+				padding[i][ordering] = { spaces, (uint8_t)pad };
+			}
+		}
+	}
+};
+
+const InternedStrings interned;
+}
+
+class TokenWriter {
+public:
+	explicit TokenWriter(TokenList& list)
+		: list(list)
+	{
+	}
+
+	void add(TokenType type, const char* text, size_t length, uint64_t value = 0)
+	{
+		list.tokens[list.count++] = { type, (uint8_t)length, text, value };
+	}
+
+	void add(TokenType type, const InternedString& str, uint64_t value = 0)
+	{
+		add(type, str.text, str.length, value);
+	}
+
+	void reg(uint32_t reg)
+	{
+		add(TokenType::Register, interned.registers[reg], reg);
+	}
+
+	void freg(uint32_t encoding)
+	{
+		reg(fpRegister(encoding));
+	}
+
+	void separator(const char* text, size_t length)
+	{
+		add(TokenType::OperandSeparator, text, length);
+	}
+
+	void comma()
+	{
+		separator(", ", 2);
+	}
+
+	void integer(TokenType type, int64_t value)
+	{
+		char* start = list.scratch + list.scratchUsed;
+		char* end = std::to_chars(start, list.scratch + sizeof(list.scratch), value).ptr;
+		list.scratchUsed += end - start;
+		add(type, start, end - start, (uint64_t)value);
+	}
+
+	// Named CSRs print as keywords, others as their number
+	void csr(uint32_t number)
+	{
+		const char* name = Csr::name(number);
+		if (name)
+			add(TokenType::Keyword, name, strlen(name), number);
+		else
+			hex(TokenType::Integer, number);
+	}
+
+	void target(uint64_t target)
+	{
+		hex(TokenType::PossibleAddress, target);
+	}
+
+	void hex(TokenType type, uint64_t value)
+	{
+		char* start = list.scratch + list.scratchUsed;
+		start[0] = '0';
+		start[1] = 'x';
+		char* end = std::to_chars(start + 2, list.scratch + sizeof(list.scratch), value, 16).ptr;
+		list.scratchUsed += end - start;
+		add(type, start, end - start, value);
+	}
+
+	void address(const Instruction& instr)
+	{
+		separator("(", 1);
+		reg(instr.rs1);
+		add(TokenType::Text, ")", 1);
+	}
+
+	void memory(const Instruction& instr)
+	{
+		integer(TokenType::CodeRelativeAddress, instr.imm);
+		address(instr);
+	}
+
+private:
+	TokenList& list;
+};
+
+template <unsigned Xlen>
+void Formatter::render(const Instruction& instr, uint64_t addr, TokenList& out)
+{
+	out.clear();
+	if (instr.type == InstrType::Error)
+		return;
+
+	TokenWriter w(out);
+	const uint32_t ordering = isAtomic(instr.mnemonic) ? instr.ordering() : 0;
+	w.add(TokenType::Instruction, interned.mnemonics[instr.mnemonic][ordering]);
+	w.add(TokenType::Text, interned.padding[instr.mnemonic][ordering]);
+	w.add(TokenType::Text, " ", 1);
+
+	switch (instrOperands[instr.mnemonic]) {
+	case RdRs1Rs2:
+		w.reg(instr.rd);
+		w.comma();
+		w.reg(instr.rs1);
+		w.comma();
+		w.reg(instr.rs2);
+		break;
+	case RdRs1Imm:
+	case RdRs1Shamt:
+		w.reg(instr.rd);
+		w.comma();
+		w.reg(instr.rs1);
+		w.comma();
+		w.integer(TokenType::Integer, instr.imm);
+		break;
+	case RdRs1:
+		w.reg(instr.rd);
+		w.comma();
+		w.reg(instr.rs1);
+		break;
+	case RdImm:
+		w.reg(instr.rd);
+		w.comma();
+		w.integer(TokenType::Integer, instr.imm);
+		break;
+	case RdMem:
+		w.reg(instr.rd);
+		w.comma();
+		w.memory(instr);
+		break;
+	case Rs2Mem:
+		w.reg(instr.rs2);
+		w.comma();
+		w.memory(instr);
+		break;
+	case Rs1Rs2Target:
+		w.reg(instr.rs1);
+		w.comma();
+		w.reg(instr.rs2);
+		w.comma();
+		w.target(targetAddr<Xlen>(addr, instr.imm));
+		break;
+	case RdTarget:
+		w.reg(instr.rd);
+		w.comma();
+		w.target(targetAddr<Xlen>(addr, instr.imm));
+		break;
+	case Target:
+		w.target(targetAddr<Xlen>(addr, instr.imm));
+		break;
+	case Rs1:
+		w.reg(instr.rs1);
+		break;
+	case FdFs1Fs2:
+		w.freg(instr.rd);
+		w.comma();
+		w.freg(instr.rs1);
+		w.comma();
+		w.freg(instr.rs2);
+		break;
+	case FdFs1Fs2Fs3:
+		w.freg(instr.rd);
+		w.comma();
+		w.freg(instr.rs1);
+		w.comma();
+		w.freg(instr.rs2);
+		w.comma();
+		w.freg(instr.rs3());
+		break;
+	case FdFs1:
+		w.freg(instr.rd);
+		w.comma();
+		w.freg(instr.rs1);
+		break;
+	case FdRs1:
+		w.freg(instr.rd);
+		w.comma();
+		w.reg(instr.rs1);
+		break;
+	case RdFs1:
+		w.reg(instr.rd);
+		w.comma();
+		w.freg(instr.rs1);
+		break;
+	case RdFs1Fs2:
+		w.reg(instr.rd);
+		w.comma();
+		w.freg(instr.rs1);
+		w.comma();
+		w.freg(instr.rs2);
+		break;
+	case FdMem:
+		w.freg(instr.rd);
+		w.comma();
+		w.memory(instr);
+		break;
+	case Fs2Mem:
+		w.freg(instr.rs2);
+		w.comma();
+		w.memory(instr);
+		break;
+	case RdAddr:
+		w.reg(instr.rd);
+		w.comma();
+		w.address(instr);
+		break;
+	case RdRs2Addr:
+		w.reg(instr.rd);
+		w.comma();
+		w.reg(instr.rs2);
+		w.comma();
+		w.address(instr);
+		break;
+	case RdCsr:
+		w.reg(instr.rd);
+		w.comma();
+		w.csr(instr.csr());
+		break;
+	case CsrRs1:
+		w.csr(instr.csr());
+		w.comma();
+		w.reg(instr.rs1);
+		break;
+	case CsrUimm:
+		w.csr(instr.csr());
+		w.comma();
+		w.integer(TokenType::Integer, instr.rs1);
+		break;
+	case RdCsrRs1:
+		w.reg(instr.rd);
+		w.comma();
+		w.csr(instr.csr());
+		w.comma();
+		w.reg(instr.rs1);
+		break;
+	case RdCsrUimm:
+		w.reg(instr.rd);
+		w.comma();
+		w.csr(instr.csr());
+		w.comma();
+		w.integer(TokenType::Integer, instr.rs1);
+		break;
+	case Rs1Rs2:
+		w.reg(instr.rs1);
+		w.comma();
+		w.reg(instr.rs2);
+		break;
+	case NoOperands:
+		break;
+	}
+}
+
+template void Formatter::render<32>(const Instruction& instr, uint64_t addr, TokenList& out);
+template void Formatter::render<64>(const Instruction& instr, uint64_t addr, TokenList& out);
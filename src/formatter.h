@@ -0,0 +1,69 @@
+#ifndef BN_RISCV_ARCH_FORMATTER_H
+#define BN_RISCV_ARCH_FORMATTER_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "disassembler.h"
+
+// Kinds of text token, mirroring the Binary Ninja token types the plugin maps them to
+enum class TokenType : uint8_t {
+	Instruction,
+	Text,
+	OperandSeparator,
+	Register,
+	Integer,
+	PossibleAddress,
+	CodeRelativeAddress,
+	// Named CSRs, which are not registers of the architecture
+	Keyword
+};
+
+// Token text is not owned, it points either at an interned string or into the
+// scratch buffer of the TokenList the token belongs to
+struct Token {
+	TokenType type;
+	uint8_t length;
+	const char* text;
+	uint64_t value;
+};
+
+// Tokens of one rendered instruction. Capacity is fixed so rendering never
+// allocates. Tokens may point into scratch, so the list cannot be copied.
+class TokenList {
+public:
+	static constexpr size_t Capacity = 16;
+
+	TokenList() = default;
+	TokenList(const TokenList&) = delete;
+	TokenList& operator=(const TokenList&) = delete;
+
+	size_t size() const { return count; }
+	const Token* begin() const { return tokens; }
+	const Token* end() const { return tokens + count; }
+	const Token& operator[](size_t i) const { return tokens[i]; }
+
+	void clear()
+	{
+		count = 0;
+		scratchUsed = 0;
+	}
+
+private:
+	friend class TokenWriter;
+
+	Token tokens[Capacity];
+	size_t count = 0;
+	char scratch[96];
+	size_t scratchUsed = 0;
+};
+
+// Renders decoded instructions as disassembly text
+class Formatter {
+public:
+	// Xlen selects where branch and jump targets wrap
+	template <unsigned Xlen = 64>
+	static void render(const Instruction& instr, uint64_t addr, TokenList& out);
+};
+
+#endif // BN_RISCV_ARCH_FORMATTER_H
@@ -0,0 +1,102 @@
+#include "globalPointer.h"
+#include "disassembler.h"
+
+#include <atomic>
+
+namespace {
+struct Entry {
+	bool found;
+	uint64_t value;
+};
+
+// Stored on each view, so it goes away with the view and is saved with it.
+// Views without a global pointer store false.
+constexpr const char* MetadataKey = "riscv.globalPointer";
+
+// Bumped whenever a view's gp is resolved. Each thread keeps the last view it
+// looked up, which is only used while the generation matches, so a new view
+// at the address of a closed one never sees the closed view's gp.
+std::atomic<uint64_t> generation { 1 };
+
+struct CachedLookup {
+	BNBinaryView* view = nullptr;
+	uint64_t generation = 0;
+	Entry entry;
+};
+
+thread_local CachedLookup lastLookup;
+
+// Instructions searched from the entry point for the code that sets gp
+constexpr size_t EntryScanLength = 64;
+
+template <unsigned Xlen>
+Entry scanEntryPoint(BinaryView* view)
+{
+	const uint64_t entry = view->GetEntryPoint();
+	uint8_t code[EntryScanLength];
+	const size_t length = view->Read(code, entry, EntryScanLength);
+
+	bool upperKnown = false;
+	uint64_t upper = 0;
+	for (size_t offset = 0; offset < length;) {
+		const Instruction instr = Disassembler::disasm<Xlen>(code + offset, length - offset, entry + offset);
+		if (instr.type == InstrType::Error)
+			break;
+
+		const int64_t hi = (int32_t)((uint32_t)instr.imm << 12);
+		if (instr.rd == Registers::gp) {
+			if (instr.mnemonic == InstrName::AUIPC || instr.mnemonic == InstrName::LUI) {
+				upper = (instr.mnemonic == InstrName::AUIPC ? entry + offset : 0) + hi;
+				upperKnown = true;
+			} else if (instr.mnemonic == InstrName::ADDI && instr.rs1 == Registers::gp && upperKnown)
+				return { true, targetAddr<Xlen>(upper, instr.imm) };
+			else
+				upperKnown = false;
+		}
+		if (Disassembler::isControlFlow(instr.mnemonic))
+			break;
+		offset += instr.size;
+	}
+	return { false, 0 };
+}
+
+Entry find(BinaryView* view)
+{
+	Ref<Symbol> symbol = view->GetSymbolByRawName("__global_pointer$");
+	if (symbol)
+		return { true, symbol->GetAddress() };
+
+	Ref<Architecture> arch = view->GetDefaultArchitecture();
+	if (arch && arch->GetAddressSize() == 4)
+		return scanEntryPoint<32>(view);
+	return scanEntryPoint<64>(view);
+}
+}
+
+void GlobalPointer::resolve(BinaryView* view)
+{
+	const Entry entry = find(view);
+	if (entry.found) {
+		LogDebug("RISC-V: global pointer is 0x%llx", (unsigned long long)entry.value);
+		view->StoreMetadata(MetadataKey, new Metadata(entry.value), true);
+	} else
+		view->StoreMetadata(MetadataKey, new Metadata(false), true);
+	generation.fetch_add(1, std::memory_order_release);
+}
+
+bool GlobalPointer::lookup(BinaryView* view, uint64_t& value)
+{
+	const uint64_t current = generation.load(std::memory_order_acquire);
+	if (lastLookup.view != view->GetObject() || lastLookup.generation != current) {
+		Ref<Metadata> stored = view->QueryMetadata(MetadataKey);
+		if (!stored) {
+			resolve(view);
+			stored = view->QueryMetadata(MetadataKey);
+		}
+		const bool found = stored && stored->IsUnsignedInteger();
+		lastLookup = { view->GetObject(), current, { found, found ? stored->GetUnsignedInteger() : 0 } };
+	}
+
+	value = lastLookup.entry.value;
+	return lastLookup.entry.found;
+}
@@ -0,0 +1,23 @@
+#ifndef BN_RISCV_ARCH_GLOBALPOINTER_H
+#define BN_RISCV_ARCH_GLOBALPOINTER_H
+
+#include <binaryninjaapi.h>
+
+using namespace BinaryNinja;
+
+// Value of gp for each view. Linker relaxation turns most accesses to small
+// globals into gp-relative loads, stores and addis, which the lifter folds
+// into constant pointers once gp is known.
+class GlobalPointer {
+public:
+	// Looks up gp from the __global_pointer$ symbol, or from the auipc/addi or
+	// lui/addi pair that sets it at the entry point, and stores it in the
+	// view's metadata. Called when a view is finalized.
+	static void resolve(BinaryView* view);
+
+	// Value of gp for view, resolved on first use. Repeated lookups of the
+	// same view on a thread take no locks.
+	static bool lookup(BinaryView* view, uint64_t& value);
+};
+
+#endif // BN_RISCV_ARCH_GLOBALPOINTER_H
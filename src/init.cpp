@@ -1,23 +1,210 @@
+#include "diagnostics.h"
+#include "globalPointer.h"
+#include "jumpTableResolver.h"
+#include "profiler.h"
+#include "prologueScanner.h"
 #include "riscvArch.h"
 #include "riscvCallingConvention.h"
+#include "tracer.h"
+
+#include <cstdio>
 
 using namespace BinaryNinja;
+
+static void logDiagnostic(Diagnostics::Level level, const char* message)
+{
+	static const BNLogLevel levels[] = { DebugLog, InfoLog, WarningLog, ErrorLog };
+	Log(levels[level], "%s", message);
+}
+
+// Queues every likely function start in the executable segments for
+// analysis, so stripped images do not depend on linear sweep alone
+static void scanFunctionStarts(BinaryView* view)
+{
+	Ref<Platform> platform = view->GetDefaultPlatform();
+	if (!platform)
+		return;
+	const bool rv32 = platform->GetArchitecture()->GetAddressSize() == 4;
+
+	size_t added = 0;
+	for (const Ref<Segment>& segment : view->GetSegments()) {
+		if (!(segment->GetFlags() & SegmentExecutable))
+			continue;
+
+		DataBuffer code = view->ReadBuffer(segment->GetStart(), segment->GetLength());
+		const uint8_t* data = (const uint8_t*)code.GetData();
+		const std::vector<uint64_t> starts = rv32
+			? PrologueScanner::scan<32>(data, code.GetLength(), segment->GetStart())
+			: PrologueScanner::scan<64>(data, code.GetLength(), segment->GetStart());
+		for (uint64_t start : starts)
+			view->AddFunctionForAnalysis(platform, start);
+		added += starts.size();
+	}
+	LogDebug("RISC-V: queued %zu function start candidates", added);
+}
+
+static void updateVerbose(BinaryView* view)
+{
+	Diagnostics::setVerbose(view->GetObject(),
+		Settings::Instance()->Get<bool>("riscv.logUndecodableInstructions", view));
+}
+
+// Summarizes the undecodable words after every analysis pass of a RISC-V
+// view, and picks up changes to the verbose logging setting. Completion
+// events fire once, so each one adds the next.
+static void flushAfterAnalysis(Ref<BinaryView> view)
+{
+	view->AddAnalysisCompletionEvent([view]() {
+		Diagnostics::flush(view->GetObject());
+		updateVerbose(view);
+		flushAfterAnalysis(view);
+	});
+}
+
+// Logs the counts a rate-limited summary held back once a view goes away
+class DiagnosticsCloser : public ObjectDestructor {
+public:
+	void DestructBinaryView(BinaryView* view) override { Diagnostics::closeView(view->GetObject()); }
+};
+
+// Adds an architecture along with its calling convention
+static Architecture* registerArchitecture(Architecture* arch)
+{
+	Architecture::Register(arch);
+	riscvCallingConvention* callConv = new riscvCallingConvention(arch);
+	arch->RegisterCallingConvention(callConv);
+	arch->SetDefaultCallingConvention(callConv);
+	return arch;
+}
+
+static bool isRiscvArchitecture(Architecture* arch)
+{
+	const std::string name = arch->GetName();
+	return name == "RISC-V" || name == "rv64be" || name == "rv32" || name == "rv32be";
+}
+
+#define EM_RISCV 243
+#define ELFCLASS32 1
+
+// The ELF machine is the same for both widths, the class tells them apart.
+// 64-bit images keep whatever platform the ELF view picks for RISC-V.
+static Ref<Platform> elfPlatform(Metadata* metadata, Architecture* rv32)
+{
+	Ref<Metadata> elfClass = metadata->Get("EI_CLASS");
+	if (elfClass && elfClass->IsUnsignedInteger() && elfClass->GetUnsignedInteger() == ELFCLASS32)
+		return rv32->GetStandalonePlatform();
+	return nullptr;
+}
+
+#ifdef BN_RISCV_PROFILE
+static void saveProfilingReport(BinaryView*)
+{
+	std::string path;
+	if (!GetSaveFileNameInput(path, "Save RISC-V profiling report", "*.json", "riscv-profile.json"))
+		return;
+
+	FILE* file = fopen(path.c_str(), "w");
+	if (!file) {
+		LogError("RISC-V: could not open %s", path.c_str());
+		return;
+	}
+	const std::string report = Profiler::report();
+	fwrite(report.data(), 1, report.size(), file);
+	fclose(file);
+	LogInfo("RISC-V: saved profiling report to %s", path.c_str());
+}
+#endif
+
+#ifdef BN_RISCV_TRACE
+static void saveTrace(BinaryView*)
+{
+	std::string path;
+	if (!GetSaveFileNameInput(path, "Save RISC-V trace", "*.json", "riscv-trace.json"))
+		return;
+
+	const int64_t events = Tracer::save(path);
+	if (events < 0)
+		LogError("RISC-V: could not open %s", path.c_str());
+	else
+		LogInfo("RISC-V: saved %lld trace events to %s", (long long)events, path.c_str());
+}
+#endif
+
 extern "C" {
 BN_DECLARE_CORE_ABI_VERSION
 
 BINARYNINJAPLUGIN bool CorePluginInit()
 {
-	Architecture* riscv = new riscvArch("RISC-V", LittleEndian);
-	Architecture::Register(riscv);
+	// RV64 little-endian keeps the original name so existing databases load
+	Architecture* rv64 = registerArchitecture(new riscvArch<64, LittleEndian>("RISC-V"));
+	Architecture* rv64be = registerArchitecture(new riscvArch<64, BigEndian>("rv64be"));
+	Architecture* rv32 = registerArchitecture(new riscvArch<32, LittleEndian>("rv32"));
+	Architecture* rv32be = registerArchitecture(new riscvArch<32, BigEndian>("rv32be"));
 
-	// Calling Convention
-	riscvCallingConvention* riscvCallConv = new riscvCallingConvention(riscv);
-	riscv->RegisterCallingConvention(riscvCallConv);
-	riscv->SetDefaultCallingConvention(riscvCallConv);
+	rv64->RegisterFunctionRecognizer(new JumpTableResolver<64>());
+	rv64be->RegisterFunctionRecognizer(new JumpTableResolver<64>());
+	rv32->RegisterFunctionRecognizer(new JumpTableResolver<32>());
+	rv32be->RegisterFunctionRecognizer(new JumpTableResolver<32>());
 
-#define EM_RISCV 243
-	BinaryViewType::RegisterArchitecture("ELF", EM_RISCV, BigEndian, riscv);
-	BinaryViewType::RegisterArchitecture("ELF", EM_RISCV, LittleEndian, riscv);
+	BinaryViewType::RegisterArchitecture("ELF", EM_RISCV, BigEndian, rv64be);
+	BinaryViewType::RegisterArchitecture("ELF", EM_RISCV, LittleEndian, rv64);
+
+	Ref<BinaryViewType> elf = BinaryViewType::GetByName("ELF");
+	if (elf) {
+		elf->RegisterPlatformRecognizer(EM_RISCV, LittleEndian,
+			[rv32](BinaryView*, Metadata* metadata) { return elfPlatform(metadata, rv32); });
+		elf->RegisterPlatformRecognizer(EM_RISCV, BigEndian,
+			[rv32be](BinaryView*, Metadata* metadata) { return elfPlatform(metadata, rv32be); });
+	}
+
+	Diagnostics::setHook(logDiagnostic);
+	static DiagnosticsCloser diagnosticsCloser;
+
+#ifdef BN_RISCV_PROFILE
+	PluginCommand::Register("RISC-V\\Save Profiling Report",
+		"Save callback latencies and decode counts as JSON", saveProfilingReport);
+	PluginCommand::Register("RISC-V\\Reset Profiling Counters",
+		"Clear the recorded callback latencies and decode counts", [](BinaryView*) { Profiler::reset(); });
+#endif
+#ifdef BN_RISCV_TRACE
+	PluginCommand::Register("RISC-V\\Save Trace",
+		"Save the recent decode and lift callbacks as a Chrome trace", saveTrace);
+	PluginCommand::Register("RISC-V\\Clear Trace",
+		"Drop the buffered trace events", [](BinaryView*) { Tracer::clear(); });
+#endif
+
+	Ref<Settings> settings = Settings::Instance();
+	settings->RegisterGroup("riscv", "RISC-V");
+	settings->RegisterSetting("riscv.logUndecodableInstructions",
+		R"({
+			"title" : "Log Every Undecodable Instruction",
+			"type" : "boolean",
+			"default" : false,
+			"description" : "Log the address of every instruction word the decoder rejects instead of a per-analysis summary. Slow on images with large data regions.",
+			"ignore" : ["SettingsProjectScope", "SettingsResourceScope"]
+		})");
+	Diagnostics::setVerbose(settings->Get<bool>("riscv.logUndecodableInstructions"));
+	settings->RegisterSetting("riscv.scanFunctionStarts",
+		R"({
+			"title" : "Scan For Function Starts",
+			"type" : "boolean",
+			"default" : true,
+			"description" : "Before analysis, scan executable segments for function prologues and call targets and add them as functions. Helps with stripped images.",
+			"ignore" : ["SettingsProjectScope", "SettingsResourceScope"]
+		})");
+
+	BinaryViewType::RegisterBinaryViewFinalizationEvent([](BinaryView* view) {
+		Ref<Architecture> arch = view->GetDefaultArchitecture();
+		if (!arch || !isRiscvArchitecture(arch))
+			return;
+
+		Diagnostics::openView(view->GetObject(), view->GetStart(), view->GetEnd());
+		updateVerbose(view);
+		flushAfterAnalysis(view);
+		GlobalPointer::resolve(view);
+		if (Settings::Instance()->Get<bool>("riscv.scanFunctionStarts", view))
+			scanFunctionStarts(view);
+	});
 	return true;
 }
 }
\ No newline at end of file
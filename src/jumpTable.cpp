@@ -0,0 +1,171 @@
+#include "jumpTable.h"
+
+namespace {
+bool writesRd(const Instruction& instr)
+{
+	if (instr.mnemonic == InstrName::UNSUPPORTED || instr.rd == Registers::Zero)
+		return false;
+
+	switch (instrOperands[instr.mnemonic]) {
+	case RdRs1Rs2:
+	case RdRs1Imm:
+	case RdRs1Shamt:
+	case RdRs1:
+	case RdImm:
+	case RdMem:
+	case RdTarget:
+	case RdFs1:
+	case RdFs1Fs2:
+	case RdAddr:
+	case RdRs2Addr:
+	case RdCsr:
+	case RdCsrRs1:
+	case RdCsrUimm:
+		return true;
+	default:
+		return false;
+	}
+}
+
+// Index of the last instruction before end that writes reg, or -1
+int definition(const Instruction* instrs, int end, uint32_t reg)
+{
+	for (int i = end - 1; i >= 0; i--) {
+		if (writesRd(instrs[i]) && instrs[i].rd == reg)
+			return i;
+	}
+	return -1;
+}
+
+// Value of reg just before instrs[end], if it is built from constants
+bool constantValue(const Instruction* instrs, const uint64_t* addrs, int end, uint32_t reg,
+	uint64_t& value)
+{
+	const int def = definition(instrs, end, reg);
+	if (def < 0)
+		return false;
+
+	const Instruction& instr = instrs[def];
+	const int64_t upper = (int32_t)((uint32_t)instr.imm << 12);
+	switch (instr.mnemonic) {
+	case InstrName::LUI:
+		value = upper;
+		return true;
+	case InstrName::AUIPC:
+		value = addrs[def] + upper;
+		return true;
+	case InstrName::LI:
+		value = (int64_t)instr.imm;
+		return true;
+	case InstrName::ADDI:
+		if (!constantValue(instrs, addrs, def, instr.rs1, value))
+			return false;
+		value += (int64_t)instr.imm;
+		return true;
+	case InstrName::MV:
+		return constantValue(instrs, addrs, def, instr.rs1, value);
+	default:
+		return false;
+	}
+}
+
+bool isTableLoad(const Instruction& instr)
+{
+	return instr.mnemonic == InstrName::LW || instr.mnemonic == InstrName::LWU
+		|| instr.mnemonic == InstrName::LD;
+}
+
+// Number of entries allowed by an unsigned bounds check on index before
+// instrs[end], or 0 if there is none
+size_t boundsCheck(const Instruction* instrs, const uint64_t* addrs, int end, uint32_t index)
+{
+	for (int i = end - 1; i >= 0; i--) {
+		const Instruction& instr = instrs[i];
+		if (writesRd(instr) && instr.rd == index)
+			return 0;
+
+		uint64_t limit;
+		// bgeu index, limit, default
+		if (instr.mnemonic == InstrName::BGEU && instr.rs1 == index
+			&& constantValue(instrs, addrs, i, instr.rs2, limit))
+			return limit;
+		// bgtu index, limit, default (bltu limit, index)
+		if (instr.mnemonic == InstrName::BLTU && instr.rs2 == index
+			&& constantValue(instrs, addrs, i, instr.rs1, limit))
+			return limit + 1;
+	}
+	return 0;
+}
+}
+
+bool JumpTable::match(const Instruction* instrs, const uint64_t* addrs, size_t count, Pattern& out)
+{
+	if (count < 4)
+		return false;
+
+	const int jump = (int)count - 1;
+	if (Disassembler::flowKind(instrs[jump]) != FlowIndirectJump || instrs[jump].imm != 0)
+		return false;
+
+	Pattern table {};
+	int load = definition(instrs, jump, instrs[jump].rs1);
+	if (load < 0)
+		return false;
+
+	// Relative tables add a base address to the loaded entry
+	if (instrs[load].mnemonic == InstrName::ADD) {
+		const int base = load;
+		const Instruction& add = instrs[base];
+		const uint32_t operands[2][2] = { { add.rs1, add.rs2 }, { add.rs2, add.rs1 } };
+		load = -1;
+		for (const auto& operand : operands) {
+			const int def = definition(instrs, base, operand[0]);
+			if (def >= 0 && isTableLoad(instrs[def])
+				&& constantValue(instrs, addrs, base, operand[1], table.relativeBase)) {
+				table.relative = true;
+				load = def;
+				break;
+			}
+		}
+		if (load < 0)
+			return false;
+	}
+
+	const Instruction& entry = instrs[load];
+	if (!isTableLoad(entry))
+		return false;
+	table.entrySize = entry.mnemonic == InstrName::LD ? 8 : 4;
+	table.signedEntries = entry.mnemonic == InstrName::LW;
+
+	// The entry address is the table base plus the scaled index
+	const int address = definition(instrs, load, entry.rs1);
+	if (address < 0 || instrs[address].mnemonic != InstrName::ADD)
+		return false;
+
+	const Instruction& add = instrs[address];
+	const uint32_t operands[2][2] = { { add.rs1, add.rs2 }, { add.rs2, add.rs1 } };
+	for (const auto& operand : operands) {
+		const int shift = definition(instrs, address, operand[0]);
+		if (shift < 0 || instrs[shift].mnemonic != InstrName::SLLI
+			|| instrs[shift].imm != (table.entrySize == 8 ? 3 : 2))
+			continue;
+		if (!constantValue(instrs, addrs, address, operand[1], table.tableBase))
+			continue;
+
+		table.tableBase += (int64_t)entry.imm;
+		table.entryCount = boundsCheck(instrs, addrs, shift, instrs[shift].rs1);
+		out = table;
+		return true;
+	}
+	return false;
+}
+
+uint64_t JumpTable::target(const Pattern& table, const uint8_t* entry, bool bigEndian)
+{
+	uint64_t value = 0;
+	for (size_t i = 0; i < table.entrySize; i++)
+		value |= (uint64_t)entry[bigEndian ? table.entrySize - 1 - i : i] << (i * 8);
+	if (table.entrySize == 4 && table.signedEntries)
+		value = (int64_t)(int32_t)(uint32_t)value;
+	return table.relative ? table.relativeBase + value : value;
+}
@@ -0,0 +1,43 @@
+#ifndef BN_RISCV_ARCH_JUMPTABLE_H
+#define BN_RISCV_ARCH_JUMPTABLE_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "disassembler.h"
+
+// Recognizes the sequences GCC and LLVM emit to dispatch a switch through a
+// table of addresses, so the targets of the final jr can be read up front:
+//
+//   bgeu  a0, a1, default      bounds check, optional
+//   slli  a0, a0, 2
+//   auipc a1, %hi(table)       or lui
+//   addi  a1, a1, %lo(table)
+//   add   a0, a0, a1
+//   lw    a0, 0(a0)            lwu or ld
+//   add   a0, a0, a1           only for tables of relative entries
+//   jr    a0
+class JumpTable {
+public:
+	struct Pattern {
+		uint64_t tableBase;
+		// Relative entries are offsets from relativeBase, absolute entries are
+		// the target addresses themselves
+		bool relative;
+		uint64_t relativeBase;
+		uint8_t entrySize;
+		bool signedEntries;
+		// Number of entries allowed by the bounds check, 0 if none was found
+		size_t entryCount;
+	};
+
+	// Matches the instructions leading up to an indirect jump, which must be
+	// the last of the count instructions. addrs holds the address of each one.
+	static bool match(const Instruction* instrs, const uint64_t* addrs, size_t count, Pattern& out);
+
+	// Target address of the table entry at entry, stored in the byte order
+	// of the data
+	static uint64_t target(const Pattern& table, const uint8_t* entry, bool bigEndian);
+};
+
+#endif // BN_RISCV_ARCH_JUMPTABLE_H
@@ -0,0 +1,107 @@
+#include "jumpTableResolver.h"
+#include "decodeCache.h"
+#include "jumpTable.h"
+
+#include <algorithm>
+#include <set>
+
+namespace {
+// Instructions matched before each jr, enough for the longest dispatch
+// sequence with a bounds check and some unrelated instructions in between
+constexpr size_t MatchWindow = 16;
+
+// Tables without a bounds check end at the first entry that is not code
+constexpr size_t MaxJumpTableEntries = 4096;
+
+template <unsigned Xlen>
+Instruction decodeAt(BinaryView* view, uint64_t addr)
+{
+	uint8_t bytes[4];
+	const size_t len = view->Read(bytes, addr, sizeof(bytes));
+	return DecodeCache::decode<Xlen>(bytes, addr, len);
+}
+
+template <unsigned Xlen>
+void resolve(BinaryView* view, Function* func, Architecture* arch, const JumpTable::Pattern& match,
+	uint64_t addr)
+{
+	// The matcher computes addresses as on RV64, they wrap at 32 bits on RV32
+	const uint64_t addrMask = Xlen == 64 ? ~0ull : 0xffffffffull;
+	JumpTable::Pattern table = match;
+	table.tableBase &= addrMask;
+	table.relativeBase &= addrMask;
+
+	const bool bigEndian = view->GetDefaultEndianness() == BigEndian;
+	const size_t limit = table.entryCount ? std::min(table.entryCount, MaxJumpTableEntries) : MaxJumpTableEntries;
+	std::vector<ArchAndAddr> targets;
+	uint8_t entry[8];
+	for (size_t i = 0; i < limit; i++) {
+		if (view->Read(entry, table.tableBase + i * table.entrySize, table.entrySize) != table.entrySize)
+			break;
+		const uint64_t target = JumpTable::target(table, entry, bigEndian) & addrMask;
+		if ((target & 1) || !view->IsOffsetExecutable(target))
+			break;
+		targets.emplace_back(arch, target);
+	}
+	if (targets.empty())
+		return;
+
+	std::sort(targets.begin(), targets.end());
+	targets.erase(std::unique(targets.begin(), targets.end()), targets.end());
+
+	// Setting the branches triggers reanalysis, so only do it when they change
+	std::vector<ArchAndAddr> existing = func->GetIndirectBranchesAt(arch, addr);
+	std::sort(existing.begin(), existing.end());
+	if (existing != targets)
+		func->SetAutoIndirectBranches(arch, addr, targets);
+}
+}
+
+template <unsigned Xlen>
+bool JumpTableResolver<Xlen>::RecognizeLowLevelIL(BinaryView* view, Function* func, LowLevelILFunction* il)
+{
+	std::set<uint64_t> lifted;
+	std::vector<uint64_t> jumps;
+	for (size_t i = 0; i < il->GetInstructionCount(); i++) {
+		const LowLevelILInstruction instr = il->GetInstruction(i);
+		lifted.insert(instr.address);
+		if (instr.operation == LLIL_JUMP)
+			jumps.push_back(instr.address);
+	}
+
+	Ref<Architecture> arch = func->GetArchitecture();
+	for (uint64_t addr : jumps) {
+		const Instruction jump = decodeAt<Xlen>(view, addr);
+		if (Disassembler::flowKind(jump) != FlowIndirectJump)
+			continue;
+
+		// The run of consecutive lifted instructions that ends in the jr,
+		// which crosses into the blocks that fall through to it
+		Instruction instrs[MatchWindow];
+		uint64_t addrs[MatchWindow];
+		size_t count = 0;
+		instrs[MatchWindow - 1] = jump;
+		addrs[MatchWindow - 1] = addr;
+		count++;
+		for (auto it = lifted.find(addr); it != lifted.begin() && count < MatchWindow;) {
+			--it;
+			const size_t slot = MatchWindow - 1 - count;
+			instrs[slot] = decodeAt<Xlen>(view, *it);
+			if (instrs[slot].type == InstrType::Error || *it + instrs[slot].size != addrs[slot + 1])
+				break;
+			addrs[slot] = *it;
+			count++;
+		}
+
+		JumpTable::Pattern table;
+		const size_t first = MatchWindow - count;
+		if (JumpTable::match(instrs + first, addrs + first, count, table))
+			resolve<Xlen>(view, func, arch, table, addr);
+	}
+
+	// Other recognizers still get to look at the function
+	return false;
+}
+
+template class JumpTableResolver<32>;
+template class JumpTableResolver<64>;
@@ -0,0 +1,18 @@
+#ifndef BN_RISCV_ARCH_JUMPTABLERESOLVER_H
+#define BN_RISCV_ARCH_JUMPTABLERESOLVER_H
+
+#include <binaryninjaapi.h>
+
+using namespace BinaryNinja;
+
+// Reports the targets of switches dispatched through a jr as its indirect
+// branches. Runs once a function's low level IL is generated, and matches
+// the instructions the IL covers, so the result only depends on the
+// function and not on the order its instructions were lifted in.
+template <unsigned Xlen>
+class JumpTableResolver : public FunctionRecognizer {
+public:
+	bool RecognizeLowLevelIL(BinaryView* view, Function* func, LowLevelILFunction* il) override;
+};
+
+#endif // BN_RISCV_ARCH_JUMPTABLERESOLVER_H
@@ -1,12 +1,16 @@
 #include "lifter.h"
 #include "binaryninjaapi.h"
-#include "disassembler.h"
+#include "csr.h"
+#include "decodeCache.h"
+#include "globalPointer.h"
+#include "tracer.h"
 
-ExprId cond_branch(Architecture* arch, BinaryNinja::LowLevelILFunction& il, Instruction& inst,
+template <size_t RegSize>
+static ExprId cond_branch(Architecture* arch, BinaryNinja::LowLevelILFunction& il, Instruction& inst,
 	ExprId condition)
 {
-	const uint64_t dest = inst.imm + il.GetCurrentAddress();
-	const uint64_t nextInst = il.GetCurrentAddress() + 4;
+	const uint64_t dest = targetAddr<RegSize * 8>(il.GetCurrentAddress(), inst.imm);
+	const uint64_t nextInst = targetAddr<RegSize * 8>(il.GetCurrentAddress(), inst.size);
 
 	BNLowLevelILLabel* trueLabel = il.GetLabelForAddress(arch, dest);
 	BNLowLevelILLabel* falseLabel = il.GetLabelForAddress(arch, nextInst);
@@ -18,353 +22,1034 @@ ExprId cond_branch(Architecture* arch, BinaryNinja::LowLevelILFunction& il, Inst
 	if (trueLabel) {
 		il.AddInstruction(il.If(condition, *trueLabel, falseCode));
 		il.MarkLabel(falseCode);
-		return il.Jump(il.ConstPointer(8, nextInst));
+		return il.Jump(il.ConstPointer(RegSize, nextInst));
 	}
 
 	if (falseLabel) {
 		il.AddInstruction(il.If(condition, trueCode, *falseLabel));
 		il.MarkLabel(trueCode);
-		return il.Jump(il.ConstPointer(8, dest));
+		return il.Jump(il.ConstPointer(RegSize, dest));
 	}
 
 	il.AddInstruction(il.If(condition, trueCode, falseCode));
 	il.MarkLabel(trueCode);
-	il.AddInstruction(il.Jump(il.ConstPointer(8, dest)));
+	il.AddInstruction(il.Jump(il.ConstPointer(RegSize, dest)));
 	il.MarkLabel(falseCode);
-	return il.Jump(il.ConstPointer(8, nextInst));
+	return il.Jump(il.ConstPointer(RegSize, nextInst));
 }
 
-ExprId store_helper(BinaryNinja::LowLevelILFunction& il, Instruction& inst,
-	uint64_t size)
+// Address of a gp-relative operand as a constant, when the function's view
+// has a known global pointer
+static bool gp_relative(BinaryNinja::LowLevelILFunction& il, const Instruction& inst, uint64_t& addr)
+{
+	if (inst.rs1 != Registers::gp)
+		return false;
+
+	Ref<Function> func = il.GetFunction();
+	uint64_t gp;
+	if (!func || !GlobalPointer::lookup(func->GetView(), gp))
+		return false;
+
+	addr = gp + (int64_t)inst.imm;
+	return true;
+}
+
+// Immediate of lui and auipc, sign-extended from 32 bits as on RV64
+static int64_t upper_imm(const Instruction& inst)
+{
+	return (int32_t)((uint32_t)inst.imm << 12);
+}
+
+// Value inst computes from rs1 and its immediate when the instruction just
+// before it is the lui or auipc that sets rs1, as in the pairs that build
+// addresses and 32-bit constants. Only the second instruction of a pair is
+// fused, so each lift still covers the one instruction GetInstructionInfo
+// reported and the lui or auipc keeps its own IL at its own address. An
+// instruction that starts a block can be reached without the first half,
+// so it is never fused. sp, gp and tp are never set this way, and skipping
+// them avoids reading the view for most loads and stores.
+template <size_t RegSize>
+static bool fused_pair(Architecture* arch, BinaryNinja::LowLevelILFunction& il, const Instruction& inst,
+	uint64_t addr, uint64_t& value)
+{
+	if (inst.rs1 == Registers::Zero || inst.rs1 == Registers::sp || inst.rs1 == Registers::gp
+		|| inst.rs1 == Registers::tp || addr < 4 || il.GetLabelForAddress(arch, addr))
+		return false;
+
+	Ref<Function> func = il.GetFunction();
+	uint8_t bytes[4];
+	if (!func || func->GetView()->Read(bytes, addr - 4, sizeof(bytes)) != sizeof(bytes))
+		return false;
+	const Instruction upper = DecodeCache::decode<RegSize * 8>(bytes, addr - 4, sizeof(bytes));
+	if (upper.size != 4 || upper.rd != inst.rs1)
+		return false;
+
+	if (upper.mnemonic == InstrName::LUI)
+		value = targetAddr<RegSize * 8>(0, upper_imm(upper));
+	else if (upper.mnemonic == InstrName::AUIPC)
+		value = targetAddr<RegSize * 8>(addr - 4, upper_imm(upper));
+	else
+		return false;
+	value = targetAddr<RegSize * 8>(value, inst.imm);
+	return true;
+}
+
+// Effective address of a load or store
+template <size_t RegSize>
+static ExprId mem_address(Architecture* arch, BinaryNinja::LowLevelILFunction& il, const Instruction& inst,
+	uint64_t addr)
+{
+	uint64_t value;
+	if (gp_relative(il, inst, value) || fused_pair<RegSize>(arch, il, inst, addr, value))
+		return il.ConstPointer(RegSize, value);
+	return il.Add(RegSize, il.Register(RegSize, inst.rs1), il.Const(RegSize, inst.imm));
+}
+
+template <size_t RegSize>
+static ExprId store_helper(Architecture* arch, BinaryNinja::LowLevelILFunction& il, Instruction& inst,
+	uint64_t addr, uint64_t size)
 {
 	if (inst.rs2 == Registers::Zero) {
 		return il.Nop();
 	}
-	const ExprId addr = il.Add(8, il.Register(8, inst.rs1), il.Const(8, inst.imm));
-	const ExprId val = il.Register(8, inst.rs2);
-	return il.Store(size, addr, val);
+	const ExprId address = mem_address<RegSize>(arch, il, inst, addr);
+	const ExprId val = il.Register(RegSize, inst.rs2);
+	return il.Store(size, address, val);
 };
 
-ExprId load_helper(BinaryNinja::LowLevelILFunction& il, Instruction& inst,
-	uint64_t size, bool shouldZeroExtend)
+template <size_t RegSize>
+static ExprId load_helper(Architecture* arch, BinaryNinja::LowLevelILFunction& il, Instruction& inst,
+	uint64_t addr, uint64_t size, bool shouldZeroExtend)
 {
 	if (inst.rd == Registers::Zero) {
 		return il.Nop();
 	}
-	const ExprId addr = il.Add(8, il.Register(8, inst.rs1), il.Const(8, inst.imm));
-	if (inst.mnemonic == InstrName::LW)
-		return il.SetRegister(8, inst.rd, il.Load(size, addr));
+	const ExprId address = mem_address<RegSize>(arch, il, inst, addr);
+	// Loads narrower than XLEN extend to the full register
+	if (size == RegSize)
+		return il.SetRegister(RegSize, inst.rd, il.Load(size, address));
 	else if (shouldZeroExtend)
-		return il.SetRegister(8, inst.rd, il.ZeroExtend(8, il.Load(size, addr)));
+		return il.SetRegister(RegSize, inst.rd, il.ZeroExtend(RegSize, il.Load(size, address)));
 	else
-		return il.SetRegister(8, inst.rd, il.SignExtend(8, il.Load(size, addr)));
+		return il.SetRegister(RegSize, inst.rd, il.SignExtend(RegSize, il.Load(size, address)));
 }
 
-void liftToLowLevelIL(Architecture* arch, const uint8_t* data, uint64_t addr, size_t& len,
-	BinaryNinja::LowLevelILFunction& il)
+#define LIFT(name) template <size_t RegSize> static ExprId name(Architecture* arch, BinaryNinja::LowLevelILFunction& il, Instruction& inst, uint64_t addr)
+
+LIFT(liftLui)
 {
-	Instruction inst = Disassembler::disasm(data, addr);
-	ExprId expr = il.Unimplemented();
-	switch (inst.mnemonic) {
-	case ADDI:
-		expr = il.SetRegister(
-			8, inst.rd, il.Add(8, il.Register(8, inst.rs1), il.Const(8, inst.imm)));
-		break;
-	case ADD:
-		expr = il.SetRegister(
-			8, inst.rd,
-			il.Add(8, il.Register(8, inst.rs1), il.Register(8, inst.rs2)));
-		break;
-	case SUB:
-		expr = il.SetRegister(
-			8, inst.rd,
-			il.Sub(8, il.Register(8, inst.rs1), il.Register(8, inst.rs2)));
-		break;
-	case AUIPC:
-		expr = il.SetRegister(8, inst.rd, il.Const(4, (inst.imm << 12) + addr));
-		break;
-	case JAL: {
-		// link
-		il.AddInstruction(il.SetRegister(8, inst.rd, il.Const(8, addr + 4)));
-
-		// Jump
-		const ExprId target = il.Add(8, il.Const(8, addr), il.Const(8, inst.imm));
-		expr = il.Jump(target);
-	} break;
-	case JALR: {
-		// JALR has to follow a set of return-address-stack (RAS) actions
-		/*if((inst.rd == Registers::ra || inst.rd == Registers::t0) && (inst.rs1 == Registers::ra || inst.rs1 == Registers::t0)) {
-		    // Check if rs1 == rd
-		    if (inst.rs1 != inst.rd) {
-		        // pop, then push
-		        il.AddInstruction(il.Pop(8, ));
-		    }
-		    // push
-		    il.AddInstruction(il.Push(8, target));
-		} else if((inst.rd == Registers::ra || inst.rd == Registers::t0) && (inst.rs1 != Registers::ra && inst.rs1 != Registers::t0)) {
-		    // push
-		} else if((inst.rd != Registers::ra && inst.rd != Registers::t0) && (inst.rs1 == Registers::ra || inst.rs1 == Registers::t0)) {
-		    // pop
-		}*/
-
-		const ExprId target = il.Add(8, il.Const(8, inst.imm), il.Register(8, inst.rs1));
-		expr = il.Call(target);
-		/*
-		        ExprId rs1;
-		        if (inst.rs1 != Registers::Zero)
-		            rs1 = il.Register(8, inst.rs1);
-		        else
-		            rs1 = il.Const(8, 0);
-		        ExprId target = il.Add(8, rs1, il.Const(8, inst.imm));
-
-		        if (inst.rd != Registers::Zero) {
-		            il.AddInstruction(il.SetRegister(8, inst.rd, il.Add(8, rs1, il.Const(8, inst.imm + addr))));
-		        }
-		        expr = il.Jump(target);*/
-	} break;
-	case BEQ:
-		if (inst.rs2 == Registers::Zero)
-			expr = cond_branch(
-				arch,
-				il, inst,
-				il.CompareEqual(8, il.Register(8, inst.rs1), il.Const(8, 0)));
-		else
-			expr = cond_branch(arch, il, inst,
-				il.CompareEqual(8, il.Register(8, inst.rs1),
-					il.Register(8, inst.rs2)));
-		break;
-	case BNE:
-		if (inst.rs2 == Registers::Zero)
-			expr = cond_branch(
-				arch,
-				il, inst,
-				il.CompareNotEqual(8, il.Register(8, inst.rs1), il.Const(8, 0)));
-		else
-			expr = cond_branch(
-				arch, il, inst,
-				il.CompareNotEqual(8, il.Register(8, inst.rs1),
-					il.Register(8, inst.rs2)));
-		break;
-	case BLT:
-		if (inst.rs2 == Registers::Zero)
-			expr = cond_branch(arch, il, inst,
-				il.CompareSignedLessThan(8, il.Register(8, inst.rs1),
-					il.Const(8, 0)));
-		else if (inst.rs1 == Registers::Zero)
-			expr = cond_branch(arch, il, inst,
-				il.CompareSignedLessThan(8, il.Const(8, 0),
-					il.Register(8, inst.rs2)));
-		else
-			expr = cond_branch(arch, il, inst,
-				il.CompareSignedLessThan(8, il.Register(8, inst.rs1),
-					il.Register(8, inst.rs2)));
-		break;
-	case BGE:
-		if (inst.rs2 == Registers::Zero)
-			expr = cond_branch(arch, il, inst,
-				il.CompareSignedGreaterEqual(
-					8, il.Register(8, inst.rs1), il.Const(8, 0)));
-		else if (inst.rs1 == Registers::Zero)
-			expr = cond_branch(arch, il, inst,
-				il.CompareSignedGreaterEqual(
-					8, il.Const(8, 0), il.Register(8, inst.rs2)));
-		else
-			expr = cond_branch(arch, il, inst,
-				il.CompareSignedGreaterEqual(8, il.Register(8, inst.rs1),
-					il.Register(8, inst.rs2)));
-		break;
-	case BLTU:
-		expr = cond_branch(arch, il, inst,
-			il.CompareUnsignedLessThan(8, il.Register(8, inst.rs1),
-				il.Register(8, inst.rs2)));
-		break;
-	case BGEU:
-		expr = cond_branch(arch, il, inst,
-			il.CompareUnsignedGreaterEqual(8, il.Register(8, inst.rs1),
-				il.Register(8, inst.rs2)));
-		break;
-	case LB:
-		expr = load_helper(il, inst, 1, false);
-		break;
-	case LH:
-		expr = load_helper(il, inst, 2, false);
-		break;
-	case LBU:
-		expr = load_helper(il, inst, 1, true);
-		break;
-	case LHU:
-		expr = load_helper(il, inst, 2, true);
-		break;
-	case LWU:
-		expr = load_helper(il, inst, 4, true);
-		break;
-	case LW:
-		expr = load_helper(il, inst, 4, false);
-		break;
-	case LD:
-		expr = load_helper(il, inst, 8, true);
-		break;
-	case SB:
-		expr = store_helper(il, inst, 1);
-		break;
-	case SH:
-		expr = store_helper(il, inst, 2);
-		break;
-	case SW:
-		expr = store_helper(il, inst, 4);
-		break;
-	case SD:
-		expr = store_helper(il, inst, 8);
-		break;
-	case SLTI:
-		expr = il.SetRegister(8, inst.rd,
-			il.CompareSignedLessThan(8, il.Register(8, inst.rs1),
-				il.Const(8, inst.imm)));
-		break;
-	case SLTIU:
-		expr = il.SetRegister(8, inst.rd,
-			il.CompareUnsignedLessThan(8, il.Register(8, inst.rs1),
-				il.Const(8, inst.imm)));
-		break;
-	case XORI:
-		expr = il.SetRegister(4, inst.rd,
-			il.Xor(4, il.Register(4, inst.rs1),
-				il.SignExtend(4, il.Const(3, inst.imm))));
-		break;
-	case ORI:
-		expr = il.SetRegister(4, inst.rd,
-			il.Or(4, il.Register(4, inst.rs1),
-				il.SignExtend(4, il.Const(3, inst.imm))));
-		break;
-	case ANDI:
-		expr = il.SetRegister(
-			8, inst.rd,
-			il.And(8, il.Register(8, inst.rs1), il.Const(12, inst.imm)));
-		break;
-	case SLLI:
-		expr = il.SetRegister(8, inst.rd,
-			il.ShiftLeft(8, il.Register(8, inst.rs1), il.Const(8, inst.imm)));
-		break;
-	case SRLI:
-		expr = il.SetRegister(8, inst.rd,
-			il.ArithShiftRight(8, il.Register(8, inst.rs1),
-				il.Const(8, inst.imm)));
-		break;
-	case SLL:
-		expr = il.SetRegister(8, inst.rd, il.ShiftLeft(8, il.Register(8, inst.rs1), il.Register(8, inst.rs2)));
-		break;
-	case SLT: {
-		ExprId operand;
-		if (inst.rs1 == Registers::Zero)
-			operand = il.Const(8, 0);
-		else
-			operand = il.Register(8, inst.rs1);
-
-		expr = il.SetRegister(8, inst.rd,
-			il.CompareSignedLessThan(8, operand,
-				il.Register(8, inst.rs2)));
-		break;
-	} break;
-	case SLTU: {
-		ExprId operand;
-		if (inst.rs1 == Registers::Zero)
-			operand = il.Const(8, 0);
-		else
-			operand = il.Register(8, inst.rs1);
-
-		expr = il.SetRegister(8, inst.rd,
-			il.CompareUnsignedLessThan(8, operand,
-				il.Register(8, inst.rs2)));
-		break;
+	return il.SetRegister(RegSize, inst.rd, il.Const(RegSize, upper_imm(inst)));
+}
+
+// A pointer, so dataflow folds the addi, load or jalr that completes it
+LIFT(liftAuipc)
+{
+	return il.SetRegister(RegSize, inst.rd, il.ConstPointer(RegSize, targetAddr<RegSize * 8>(addr, upper_imm(inst))));
+}
+
+LIFT(liftJ)
+{
+	return il.Jump(il.ConstPointer(RegSize, targetAddr<RegSize * 8>(addr, inst.imm)));
+}
+
+LIFT(liftJal)
+{
+	const ExprId target = il.ConstPointer(RegSize, targetAddr<RegSize * 8>(addr, inst.imm));
+	if (Disassembler::flowKind(inst) == FlowCall)
+		return il.Call(target);
+
+	// link
+	il.AddInstruction(il.SetRegister(RegSize, inst.rd, il.ConstPointer(RegSize, targetAddr<RegSize * 8>(addr, inst.size))));
+	return il.Jump(target);
+}
+
+LIFT(liftRet)
+{
+	return il.Return(il.Register(RegSize, inst.rs1));
+}
+
+// jr and jalr share a lifting, with the kind of jump picked from the
+// return-address stack hints the same way GetInstructionInfo does
+template <size_t RegSize>
+static ExprId liftIndirectJump(Architecture* arch, BinaryNinja::LowLevelILFunction& il, Instruction& inst,
+	uint64_t addr)
+{
+	// Far calls and tail calls through auipc
+	uint64_t value;
+	ExprId target;
+	if (Disassembler::flowKind(inst) != FlowReturn && fused_pair<RegSize>(arch, il, inst, addr, value))
+		target = il.ConstPointer(RegSize, value);
+	else {
+		target = il.Register(RegSize, inst.rs1);
+		if (inst.imm != 0)
+			target = il.Add(RegSize, target, il.Const(RegSize, inst.imm));
 	}
-	case XOR:
-		expr = il.SetRegister(
-			8, inst.rd,
-			il.Xor(8, il.Register(8, inst.rs1), il.Register(8, inst.rs2)));
-		break;
-	case SRL:
-		expr = il.SetRegister(8, inst.rd, il.LogicalShiftRight(8, il.Register(8, inst.rs1), il.Register(8, inst.rs2)));
-		break;
-	case SRA:
-		expr = il.SetRegister(8, inst.rd, il.ArithShiftRight(8, il.Register(8, inst.rs1), il.Register(8, inst.rs2)));
-		break;
-	case OR:
-		expr = il.SetRegister(
-			8, inst.rd,
-			il.Or(8, il.Register(8, inst.rs1), il.Register(8, inst.rs2)));
-		break;
-	case AND:
-		expr = il.SetRegister(
-			8, inst.rd,
-			il.And(8, il.Register(8, inst.rs1), il.Register(8, inst.rs2)));
-		break;
-	case FENCE:
-		expr = il.Nop();
-		break;
-	case ECALL:
-		expr = il.SystemCall();
-		break;
-	case EBREAK:
-		expr = il.Breakpoint();
-		break;
-	case SRAI:
-		expr = il.SetRegister(8, inst.rd,
-			il.ArithShiftRight(8, il.Register(8, inst.rs1), il.Const(8, inst.imm & 0xf)));
-		break;
-	case ADDIW:
-		expr = il.SetRegister(
-			8, inst.rd, il.Add(4, il.Register(4, inst.rs1), il.Const(4, inst.imm)));
-		break;
-	case SLLIW:
-		expr = il.SetRegister(
-			4, inst.rd,
-			il.ShiftLeft(4, il.Register(4, inst.rs1), il.Const(4, inst.rs2)));
-		break;
-	case SRLIW:
-		expr = il.SetRegister(4, inst.rd,
-			il.LogicalShiftRight(4, il.Register(4, inst.rs1), il.Const(4, inst.rs2)));
-		break;
-	case SRAIW:
-		expr = il.SetRegister(4, inst.rd,
-			il.ArithShiftRight(4, il.Register(4, inst.rs1), il.Const(4, inst.rs2)));
-		break;
-	case ADDW:
-		expr = il.SetRegister(4, inst.rd,
-			il.Add(4, il.Register(4, inst.rs1), il.Register(4, inst.rs2)));
-		break;
-	case SUBW:
-		expr = il.SetRegister(4, inst.rd,
-			il.Sub(4, il.Register(4, inst.rs1), il.Register(4, inst.rs2)));
-		break;
-	case SLLW:
-		expr = il.SetRegister(4, inst.rd, il.ShiftLeft(4, il.Register(4, inst.rs1), il.Register(4, inst.rs2)));
-		break;
-	case SRLW:
-		expr = il.SetRegister(4, inst.rd, il.LogicalShiftRight(4, il.Register(4, inst.rs1), il.Register(4, inst.rs2)));
-		break;
-	case SRAW:
-		expr = il.SetRegister(4, inst.rd, il.ArithShiftRight(4, il.Register(4, inst.rs1), il.Register(4, inst.rs2)));
-		break;
-	case J:
-		expr = il.Jump(il.Const(8, inst.imm));
-		break;
-	case LI:
-		expr = il.SetRegister(8, inst.rd, il.ConstPointer(8, inst.imm));
-		break;
-	case LUI:
-		expr = il.SetRegister(8, inst.rd, il.Const(4, (int64_t)(inst.imm << 12)));
+
+	switch (Disassembler::flowKind(inst)) {
+	case FlowIndirectCall:
+		return il.Call(target);
+	case FlowReturn:
+		if (inst.rd != Registers::Zero)
+			il.AddInstruction(il.SetRegister(RegSize, inst.rd, il.ConstPointer(RegSize, targetAddr<RegSize * 8>(addr, inst.size))));
+		return il.Return(target);
+	default:
+		if (inst.rd != Registers::Zero)
+			il.AddInstruction(il.SetRegister(RegSize, inst.rd, il.ConstPointer(RegSize, targetAddr<RegSize * 8>(addr, inst.size))));
+		return il.Jump(target);
+	}
+}
+
+LIFT(liftJr)
+{
+	return liftIndirectJump<RegSize>(arch, il, inst, addr);
+}
+
+LIFT(liftJalr)
+{
+	return liftIndirectJump<RegSize>(arch, il, inst, addr);
+}
+
+LIFT(liftBeq)
+{
+	if (inst.rs2 == Registers::Zero)
+		return cond_branch<RegSize>(arch, il, inst,
+			il.CompareEqual(RegSize, il.Register(RegSize, inst.rs1), il.Const(RegSize, 0)));
+	return cond_branch<RegSize>(arch, il, inst,
+		il.CompareEqual(RegSize, il.Register(RegSize, inst.rs1), il.Register(RegSize, inst.rs2)));
+}
+
+LIFT(liftBne)
+{
+	if (inst.rs2 == Registers::Zero)
+		return cond_branch<RegSize>(arch, il, inst,
+			il.CompareNotEqual(RegSize, il.Register(RegSize, inst.rs1), il.Const(RegSize, 0)));
+	return cond_branch<RegSize>(arch, il, inst,
+		il.CompareNotEqual(RegSize, il.Register(RegSize, inst.rs1), il.Register(RegSize, inst.rs2)));
+}
+
+LIFT(liftBlt)
+{
+	if (inst.rs2 == Registers::Zero)
+		return cond_branch<RegSize>(arch, il, inst,
+			il.CompareSignedLessThan(RegSize, il.Register(RegSize, inst.rs1), il.Const(RegSize, 0)));
+	if (inst.rs1 == Registers::Zero)
+		return cond_branch<RegSize>(arch, il, inst,
+			il.CompareSignedLessThan(RegSize, il.Const(RegSize, 0), il.Register(RegSize, inst.rs2)));
+	return cond_branch<RegSize>(arch, il, inst,
+		il.CompareSignedLessThan(RegSize, il.Register(RegSize, inst.rs1), il.Register(RegSize, inst.rs2)));
+}
+
+LIFT(liftBge)
+{
+	if (inst.rs2 == Registers::Zero)
+		return cond_branch<RegSize>(arch, il, inst,
+			il.CompareSignedGreaterEqual(RegSize, il.Register(RegSize, inst.rs1), il.Const(RegSize, 0)));
+	if (inst.rs1 == Registers::Zero)
+		return cond_branch<RegSize>(arch, il, inst,
+			il.CompareSignedGreaterEqual(RegSize, il.Const(RegSize, 0), il.Register(RegSize, inst.rs2)));
+	return cond_branch<RegSize>(arch, il, inst,
+		il.CompareSignedGreaterEqual(RegSize, il.Register(RegSize, inst.rs1), il.Register(RegSize, inst.rs2)));
+}
+
+LIFT(liftBltu)
+{
+	return cond_branch<RegSize>(arch, il, inst,
+		il.CompareUnsignedLessThan(RegSize, il.Register(RegSize, inst.rs1), il.Register(RegSize, inst.rs2)));
+}
+
+LIFT(liftBgeu)
+{
+	return cond_branch<RegSize>(arch, il, inst,
+		il.CompareUnsignedGreaterEqual(RegSize, il.Register(RegSize, inst.rs1), il.Register(RegSize, inst.rs2)));
+}
+
+LIFT(liftLb) { return load_helper<RegSize>(arch, il, inst, addr, 1, false); }
+LIFT(liftLh) { return load_helper<RegSize>(arch, il, inst, addr, 2, false); }
+LIFT(liftLw) { return load_helper<RegSize>(arch, il, inst, addr, 4, false); }
+LIFT(liftLbu) { return load_helper<RegSize>(arch, il, inst, addr, 1, true); }
+LIFT(liftLhu) { return load_helper<RegSize>(arch, il, inst, addr, 2, true); }
+LIFT(liftLwu) { return load_helper<RegSize>(arch, il, inst, addr, 4, true); }
+LIFT(liftLd) { return load_helper<RegSize>(arch, il, inst, addr, 8, true); }
+
+LIFT(liftSb) { return store_helper<RegSize>(arch, il, inst, addr, 1); }
+LIFT(liftSh) { return store_helper<RegSize>(arch, il, inst, addr, 2); }
+LIFT(liftSw) { return store_helper<RegSize>(arch, il, inst, addr, 4); }
+LIFT(liftSd) { return store_helper<RegSize>(arch, il, inst, addr, 8); }
+
+LIFT(liftLi)
+{
+	return il.SetRegister(RegSize, inst.rd, il.ConstPointer(RegSize, inst.imm));
+}
+
+LIFT(liftMv)
+{
+	uint64_t value;
+	if (fused_pair<RegSize>(arch, il, inst, addr, value))
+		return il.SetRegister(RegSize, inst.rd, il.ConstPointer(RegSize, value));
+	return il.SetRegister(RegSize, inst.rd, il.Register(RegSize, inst.rs1));
+}
+
+LIFT(liftAddi)
+{
+	// addi gp, gp, lo is what sets gp in the first place
+	uint64_t value;
+	if ((inst.rd != Registers::gp && gp_relative(il, inst, value)) || fused_pair<RegSize>(arch, il, inst, addr, value))
+		return il.SetRegister(RegSize, inst.rd, il.ConstPointer(RegSize, value));
+	return il.SetRegister(
+		RegSize, inst.rd, il.Add(RegSize, il.Register(RegSize, inst.rs1), il.Const(RegSize, inst.imm)));
+}
+
+LIFT(liftSlti)
+{
+	return il.SetRegister(RegSize, inst.rd,
+		il.CompareSignedLessThan(RegSize, il.Register(RegSize, inst.rs1), il.Const(RegSize, inst.imm)));
+}
+
+LIFT(liftSltiu)
+{
+	return il.SetRegister(RegSize, inst.rd,
+		il.CompareUnsignedLessThan(RegSize, il.Register(RegSize, inst.rs1), il.Const(RegSize, inst.imm)));
+}
+
+LIFT(liftXori)
+{
+	return il.SetRegister(
+		RegSize, inst.rd, il.Xor(RegSize, il.Register(RegSize, inst.rs1), il.Const(RegSize, inst.imm)));
+}
+
+LIFT(liftOri)
+{
+	return il.SetRegister(
+		RegSize, inst.rd, il.Or(RegSize, il.Register(RegSize, inst.rs1), il.Const(RegSize, inst.imm)));
+}
+
+LIFT(liftAndi)
+{
+	return il.SetRegister(
+		RegSize, inst.rd, il.And(RegSize, il.Register(RegSize, inst.rs1), il.Const(RegSize, inst.imm)));
+}
+
+LIFT(liftSlli)
+{
+	return il.SetRegister(RegSize, inst.rd,
+		il.ShiftLeft(RegSize, il.Register(RegSize, inst.rs1), il.Const(RegSize, inst.imm)));
+}
+
+LIFT(liftSrli)
+{
+	return il.SetRegister(RegSize, inst.rd,
+		il.LogicalShiftRight(RegSize, il.Register(RegSize, inst.rs1), il.Const(RegSize, inst.imm)));
+}
+
+LIFT(liftSrai)
+{
+	return il.SetRegister(RegSize, inst.rd,
+		il.ArithShiftRight(RegSize, il.Register(RegSize, inst.rs1), il.Const(RegSize, inst.imm)));
+}
+
+LIFT(liftAdd)
+{
+	return il.SetRegister(
+		RegSize, inst.rd, il.Add(RegSize, il.Register(RegSize, inst.rs1), il.Register(RegSize, inst.rs2)));
+}
+
+LIFT(liftSub)
+{
+	return il.SetRegister(
+		RegSize, inst.rd, il.Sub(RegSize, il.Register(RegSize, inst.rs1), il.Register(RegSize, inst.rs2)));
+}
+
+LIFT(liftSll)
+{
+	return il.SetRegister(RegSize, inst.rd,
+		il.ShiftLeft(RegSize, il.Register(RegSize, inst.rs1), il.Register(RegSize, inst.rs2)));
+}
+
+LIFT(liftSlt)
+{
+	ExprId operand;
+	if (inst.rs1 == Registers::Zero)
+		operand = il.Const(RegSize, 0);
+	else
+		operand = il.Register(RegSize, inst.rs1);
+
+	return il.SetRegister(RegSize, inst.rd,
+		il.CompareSignedLessThan(RegSize, operand, il.Register(RegSize, inst.rs2)));
+}
+
+LIFT(liftSltu)
+{
+	ExprId operand;
+	if (inst.rs1 == Registers::Zero)
+		operand = il.Const(RegSize, 0);
+	else
+		operand = il.Register(RegSize, inst.rs1);
+
+	return il.SetRegister(RegSize, inst.rd,
+		il.CompareUnsignedLessThan(RegSize, operand, il.Register(RegSize, inst.rs2)));
+}
+
+LIFT(liftXor)
+{
+	return il.SetRegister(
+		RegSize, inst.rd, il.Xor(RegSize, il.Register(RegSize, inst.rs1), il.Register(RegSize, inst.rs2)));
+}
+
+LIFT(liftSrl)
+{
+	return il.SetRegister(RegSize, inst.rd,
+		il.LogicalShiftRight(RegSize, il.Register(RegSize, inst.rs1), il.Register(RegSize, inst.rs2)));
+}
+
+LIFT(liftSra)
+{
+	return il.SetRegister(RegSize, inst.rd,
+		il.ArithShiftRight(RegSize, il.Register(RegSize, inst.rs1), il.Register(RegSize, inst.rs2)));
+}
+
+LIFT(liftOr)
+{
+	return il.SetRegister(
+		RegSize, inst.rd, il.Or(RegSize, il.Register(RegSize, inst.rs1), il.Register(RegSize, inst.rs2)));
+}
+
+LIFT(liftAnd)
+{
+	return il.SetRegister(
+		RegSize, inst.rd, il.And(RegSize, il.Register(RegSize, inst.rs1), il.Register(RegSize, inst.rs2)));
+}
+
+LIFT(liftFence)
+{
+	return il.Nop();
+}
+
+LIFT(liftEcall)
+{
+	return il.SystemCall();
+}
+
+LIFT(liftEbreak)
+{
+	return il.Breakpoint();
+}
+
+// lui+addiw is how 32-bit constants are built on RV64
+LIFT(liftAddiw)
+{
+	uint64_t value;
+	if (fused_pair<RegSize>(arch, il, inst, addr, value))
+		return il.SetRegister(RegSize, inst.rd, il.Const(RegSize, (int64_t)(int32_t)value));
+	return il.SetRegister(RegSize, inst.rd,
+		il.SignExtend(RegSize, il.Add(4, il.Register(4, inst.rs1), il.Const(4, inst.imm))));
+}
+
+LIFT(liftSlliw)
+{
+	return il.SetRegister(RegSize, inst.rd,
+		il.SignExtend(RegSize, il.ShiftLeft(4, il.Register(4, inst.rs1), il.Const(4, inst.imm))));
+}
+
+LIFT(liftSrliw)
+{
+	return il.SetRegister(RegSize, inst.rd,
+		il.SignExtend(RegSize, il.LogicalShiftRight(4, il.Register(4, inst.rs1), il.Const(4, inst.imm))));
+}
+
+LIFT(liftSraiw)
+{
+	return il.SetRegister(RegSize, inst.rd,
+		il.SignExtend(RegSize, il.ArithShiftRight(4, il.Register(4, inst.rs1), il.Const(4, inst.imm))));
+}
+
+LIFT(liftAddw)
+{
+	return il.SetRegister(RegSize, inst.rd,
+		il.SignExtend(RegSize, il.Add(4, il.Register(4, inst.rs1), il.Register(4, inst.rs2))));
+}
+
+LIFT(liftSubw)
+{
+	return il.SetRegister(RegSize, inst.rd,
+		il.SignExtend(RegSize, il.Sub(4, il.Register(4, inst.rs1), il.Register(4, inst.rs2))));
+}
+
+LIFT(liftSllw)
+{
+	return il.SetRegister(RegSize, inst.rd,
+		il.SignExtend(RegSize, il.ShiftLeft(4, il.Register(4, inst.rs1), il.Register(4, inst.rs2))));
+}
+
+LIFT(liftSrlw)
+{
+	return il.SetRegister(RegSize, inst.rd,
+		il.SignExtend(RegSize, il.LogicalShiftRight(4, il.Register(4, inst.rs1), il.Register(4, inst.rs2))));
+}
+
+LIFT(liftSraw)
+{
+	return il.SetRegister(RegSize, inst.rd,
+		il.SignExtend(RegSize, il.ArithShiftRight(4, il.Register(4, inst.rs1), il.Register(4, inst.rs2))));
+}
+
+// Upper half of the double-width product, from mulh and mulhu
+template <size_t RegSize>
+static ExprId mul_high(BinaryNinja::LowLevelILFunction& il, Instruction& inst, bool isSigned)
+{
+	const ExprId rs1 = il.Register(RegSize, inst.rs1);
+	const ExprId rs2 = il.Register(RegSize, inst.rs2);
+	if (isSigned)
+		return il.LowPart(RegSize, il.ArithShiftRight(RegSize * 2, il.MultDoublePrecSigned(RegSize * 2, rs1, rs2), il.Const(1, RegSize * 8)));
+	return il.LowPart(RegSize, il.LogicalShiftRight(RegSize * 2, il.MultDoublePrecUnsigned(RegSize * 2, rs1, rs2), il.Const(1, RegSize * 8)));
+}
+
+LIFT(liftMul)
+{
+	return il.SetRegister(
+		RegSize, inst.rd, il.Mult(RegSize, il.Register(RegSize, inst.rs1), il.Register(RegSize, inst.rs2)));
+}
+
+LIFT(liftMulh)
+{
+	return il.SetRegister(RegSize, inst.rd, mul_high<RegSize>(il, inst, true));
+}
+
+LIFT(liftMulhsu)
+{
+	// The unsigned high product is too large by rs2 when rs1 is negative
+	const ExprId correction = il.And(RegSize,
+		il.ArithShiftRight(RegSize, il.Register(RegSize, inst.rs1), il.Const(1, RegSize * 8 - 1)), il.Register(RegSize, inst.rs2));
+	return il.SetRegister(RegSize, inst.rd, il.Sub(RegSize, mul_high<RegSize>(il, inst, false), correction));
+}
+
+LIFT(liftMulhu)
+{
+	return il.SetRegister(RegSize, inst.rd, mul_high<RegSize>(il, inst, false));
+}
+
+LIFT(liftDiv)
+{
+	return il.SetRegister(
+		RegSize, inst.rd, il.DivSigned(RegSize, il.Register(RegSize, inst.rs1), il.Register(RegSize, inst.rs2)));
+}
+
+LIFT(liftDivu)
+{
+	return il.SetRegister(
+		RegSize, inst.rd, il.DivUnsigned(RegSize, il.Register(RegSize, inst.rs1), il.Register(RegSize, inst.rs2)));
+}
+
+LIFT(liftRem)
+{
+	return il.SetRegister(
+		RegSize, inst.rd, il.ModSigned(RegSize, il.Register(RegSize, inst.rs1), il.Register(RegSize, inst.rs2)));
+}
+
+LIFT(liftRemu)
+{
+	return il.SetRegister(
+		RegSize, inst.rd, il.ModUnsigned(RegSize, il.Register(RegSize, inst.rs1), il.Register(RegSize, inst.rs2)));
+}
+
+// The *w forms operate on the low 32 bits and sign-extend the 32-bit
+// result, including the unsigned ones
+LIFT(liftMulw)
+{
+	return il.SetRegister(RegSize, inst.rd,
+		il.SignExtend(RegSize, il.Mult(4, il.Register(4, inst.rs1), il.Register(4, inst.rs2))));
+}
+
+LIFT(liftDivw)
+{
+	return il.SetRegister(RegSize, inst.rd,
+		il.SignExtend(RegSize, il.DivSigned(4, il.Register(4, inst.rs1), il.Register(4, inst.rs2))));
+}
+
+LIFT(liftDivuw)
+{
+	return il.SetRegister(RegSize, inst.rd,
+		il.SignExtend(RegSize, il.DivUnsigned(4, il.Register(4, inst.rs1), il.Register(4, inst.rs2))));
+}
+
+LIFT(liftRemw)
+{
+	return il.SetRegister(RegSize, inst.rd,
+		il.SignExtend(RegSize, il.ModSigned(4, il.Register(4, inst.rs1), il.Register(4, inst.rs2))));
+}
+
+LIFT(liftRemuw)
+{
+	return il.SetRegister(RegSize, inst.rd,
+		il.SignExtend(RegSize, il.ModUnsigned(4, il.Register(4, inst.rs1), il.Register(4, inst.rs2))));
+}
+
+static ExprId fp_reg(BinaryNinja::LowLevelILFunction& il, size_t size, uint32_t encoding)
+{
+	return il.Register(size, fpRegister(encoding));
+}
+
+static ExprId fp_set(BinaryNinja::LowLevelILFunction& il, size_t size, uint32_t encoding, ExprId value)
+{
+	return il.SetRegister(size, fpRegister(encoding), value);
+}
+
+template <size_t RegSize>
+static ExprId fp_load(Architecture* arch, BinaryNinja::LowLevelILFunction& il, Instruction& inst, uint64_t addr,
+	size_t size)
+{
+	return fp_set(il, size, inst.rd, il.Load(size, mem_address<RegSize>(arch, il, inst, addr)));
+}
+
+template <size_t RegSize>
+static ExprId fp_store(Architecture* arch, BinaryNinja::LowLevelILFunction& il, Instruction& inst, uint64_t addr,
+	size_t size)
+{
+	return il.Store(size, mem_address<RegSize>(arch, il, inst, addr), fp_reg(il, size, inst.rs2));
+}
+
+// fmadd, fmsub, fnmsub and fnmadd: (+/-)(rs1 * rs2) (+/-) rs3
+static ExprId fp_fused(BinaryNinja::LowLevelILFunction& il, Instruction& inst, size_t size,
+	bool negateProduct, bool subtract)
+{
+	ExprId product = il.FloatMult(size, fp_reg(il, size, inst.rs1), fp_reg(il, size, inst.rs2));
+	if (negateProduct)
+		product = il.FloatNeg(size, product);
+	const ExprId addend = fp_reg(il, size, inst.rs3());
+	if (subtract)
+		return fp_set(il, size, inst.rd, il.FloatSub(size, product, addend));
+	return fp_set(il, size, inst.rd, il.FloatAdd(size, product, addend));
+}
+
+enum SignInjection {
+	SignCopy,
+	SignNegate,
+	SignXor
+};
+
+// fsgnj, fsgnjn and fsgnjx. With both sources the same register these are
+// the fmv, fneg and fabs pseudo-instructions.
+static ExprId fp_sign_inject(BinaryNinja::LowLevelILFunction& il, Instruction& inst, size_t size,
+	SignInjection kind)
+{
+	if (inst.rs1 == inst.rs2) {
+		const ExprId src = fp_reg(il, size, inst.rs1);
+		switch (kind) {
+		case SignCopy:
+			return fp_set(il, size, inst.rd, src);
+		case SignNegate:
+			return fp_set(il, size, inst.rd, il.FloatNeg(size, src));
+		default:
+			return fp_set(il, size, inst.rd, il.FloatAbs(size, src));
+		}
+	}
+
+	const uint64_t sign = 1ull << (size * 8 - 1);
+	const uint64_t magnitude = size == 8 ? ~sign : (~sign & 0xffffffff);
+	ExprId signSource = fp_reg(il, size, inst.rs2);
+	if (kind == SignNegate)
+		signSource = il.Not(size, signSource);
+	else if (kind == SignXor)
+		signSource = il.Xor(size, fp_reg(il, size, inst.rs1), signSource);
+
+	return fp_set(il, size, inst.rd,
+		il.Or(size, il.And(size, fp_reg(il, size, inst.rs1), il.Const(size, magnitude)),
+			il.And(size, signSource, il.Const(size, sign))));
+}
+
+// fclass and the unsigned conversions to integers write an integer
+// register, where x0 discards the result
+static ExprId fp_intrinsic(BinaryNinja::LowLevelILFunction& il, uint32_t output, Intrinsic intrinsic,
+	const std::vector<ExprId>& params)
+{
+	std::vector<RegisterOrFlag> outputs;
+	if (output != Registers::Zero)
+		outputs.push_back(RegisterOrFlag::Register(output));
+	return il.Intrinsic(outputs, intrinsic, params);
+}
+
+// fcvt.w and fcvt.l. The 32-bit result is sign-extended.
+template <size_t RegSize>
+static ExprId fp_to_int(BinaryNinja::LowLevelILFunction& il, Instruction& inst, size_t size,
+	size_t intSize)
+{
+	const ExprId value = il.FloatToInt(intSize, fp_reg(il, size, inst.rs1));
+	if (intSize == 4)
+		return il.SetRegister(RegSize, inst.rd, il.SignExtend(RegSize, value));
+	return il.SetRegister(RegSize, inst.rd, value);
+}
+
+// fcvt.wu converts through a zero-extended 64-bit integer, which is exact.
+// FloatToInt and IntToFloat are signed, so fcvt.lu, fcvt.wu.s/d and
+// fcvt.s/d.lu are intrinsics.
+template <size_t RegSize>
+static ExprId int_to_fp(BinaryNinja::LowLevelILFunction& il, Instruction& inst, size_t size,
+	size_t intSize, bool isUnsigned)
+{
+	ExprId value = il.Register(intSize, inst.rs1);
+	if (intSize == 4 && isUnsigned)
+		value = il.ZeroExtend(8, value);
+	return fp_set(il, size, inst.rd, il.IntToFloat(size, value));
+}
+
+LIFT(liftFlw) { return fp_load<RegSize>(arch, il, inst, addr, 4); }
+LIFT(liftFsw) { return fp_store<RegSize>(arch, il, inst, addr, 4); }
+LIFT(liftFmaddS) { return fp_fused(il, inst, 4, false, false); }
+LIFT(liftFmsubS) { return fp_fused(il, inst, 4, false, true); }
+LIFT(liftFnmsubS) { return fp_fused(il, inst, 4, true, false); }
+LIFT(liftFnmaddS) { return fp_fused(il, inst, 4, true, true); }
+
+LIFT(liftFaddS)
+{
+	return fp_set(il, 4, inst.rd, il.FloatAdd(4, fp_reg(il, 4, inst.rs1), fp_reg(il, 4, inst.rs2)));
+}
+
+LIFT(liftFsubS)
+{
+	return fp_set(il, 4, inst.rd, il.FloatSub(4, fp_reg(il, 4, inst.rs1), fp_reg(il, 4, inst.rs2)));
+}
+
+LIFT(liftFmulS)
+{
+	return fp_set(il, 4, inst.rd, il.FloatMult(4, fp_reg(il, 4, inst.rs1), fp_reg(il, 4, inst.rs2)));
+}
+
+LIFT(liftFdivS)
+{
+	return fp_set(il, 4, inst.rd, il.FloatDiv(4, fp_reg(il, 4, inst.rs1), fp_reg(il, 4, inst.rs2)));
+}
+
+LIFT(liftFsqrtS)
+{
+	return fp_set(il, 4, inst.rd, il.FloatSqrt(4, fp_reg(il, 4, inst.rs1)));
+}
+
+LIFT(liftFsgnjS) { return fp_sign_inject(il, inst, 4, SignCopy); }
+LIFT(liftFsgnjnS) { return fp_sign_inject(il, inst, 4, SignNegate); }
+LIFT(liftFsgnjxS) { return fp_sign_inject(il, inst, 4, SignXor); }
+
+LIFT(liftFminS)
+{
+	return fp_intrinsic(il, fpRegister(inst.rd), IntrinsicFminS, { fp_reg(il, 4, inst.rs1), fp_reg(il, 4, inst.rs2) });
+}
+
+LIFT(liftFmaxS)
+{
+	return fp_intrinsic(il, fpRegister(inst.rd), IntrinsicFmaxS, { fp_reg(il, 4, inst.rs1), fp_reg(il, 4, inst.rs2) });
+}
+
+LIFT(liftFcvtWS) { return fp_to_int<RegSize>(il, inst, 4, 4); }
+LIFT(liftFcvtWuS) { return fp_intrinsic(il, inst.rd, IntrinsicFcvtWuS, { fp_reg(il, 4, inst.rs1) }); }
+LIFT(liftFcvtLS) { return fp_to_int<RegSize>(il, inst, 4, 8); }
+LIFT(liftFcvtLuS) { return fp_intrinsic(il, inst.rd, IntrinsicFcvtLuS, { fp_reg(il, 4, inst.rs1) }); }
+
+LIFT(liftFmvXW)
+{
+	return il.SetRegister(RegSize, inst.rd, il.SignExtend(RegSize, fp_reg(il, 4, inst.rs1)));
+}
+
+LIFT(liftFclassS)
+{
+	return fp_intrinsic(il, inst.rd, IntrinsicFclassS, { fp_reg(il, 4, inst.rs1) });
+}
+
+LIFT(liftFeqS)
+{
+	return il.SetRegister(RegSize, inst.rd,
+		il.BoolToInt(RegSize, il.FloatCompareEqual(4, fp_reg(il, 4, inst.rs1), fp_reg(il, 4, inst.rs2))));
+}
+
+LIFT(liftFltS)
+{
+	return il.SetRegister(RegSize, inst.rd,
+		il.BoolToInt(RegSize, il.FloatCompareLessThan(4, fp_reg(il, 4, inst.rs1), fp_reg(il, 4, inst.rs2))));
+}
+
+LIFT(liftFleS)
+{
+	return il.SetRegister(RegSize, inst.rd,
+		il.BoolToInt(RegSize, il.FloatCompareLessEqual(4, fp_reg(il, 4, inst.rs1), fp_reg(il, 4, inst.rs2))));
+}
+
+LIFT(liftFcvtSW) { return int_to_fp<RegSize>(il, inst, 4, 4, false); }
+LIFT(liftFcvtSWu) { return int_to_fp<RegSize>(il, inst, 4, 4, true); }
+LIFT(liftFcvtSL) { return int_to_fp<RegSize>(il, inst, 4, 8, false); }
+LIFT(liftFcvtSLu)
+{
+	return fp_intrinsic(il, fpRegister(inst.rd), IntrinsicFcvtSLu, { il.Register(8, inst.rs1) });
+}
+
+LIFT(liftFmvWX)
+{
+	return fp_set(il, 4, inst.rd, il.Register(4, inst.rs1));
+}
+
+LIFT(liftFld) { return fp_load<RegSize>(arch, il, inst, addr, 8); }
+LIFT(liftFsd) { return fp_store<RegSize>(arch, il, inst, addr, 8); }
+LIFT(liftFmaddD) { return fp_fused(il, inst, 8, false, false); }
+LIFT(liftFmsubD) { return fp_fused(il, inst, 8, false, true); }
+LIFT(liftFnmsubD) { return fp_fused(il, inst, 8, true, false); }
+LIFT(liftFnmaddD) { return fp_fused(il, inst, 8, true, true); }
+
+LIFT(liftFaddD)
+{
+	return fp_set(il, 8, inst.rd, il.FloatAdd(8, fp_reg(il, 8, inst.rs1), fp_reg(il, 8, inst.rs2)));
+}
+
+LIFT(liftFsubD)
+{
+	return fp_set(il, 8, inst.rd, il.FloatSub(8, fp_reg(il, 8, inst.rs1), fp_reg(il, 8, inst.rs2)));
+}
+
+LIFT(liftFmulD)
+{
+	return fp_set(il, 8, inst.rd, il.FloatMult(8, fp_reg(il, 8, inst.rs1), fp_reg(il, 8, inst.rs2)));
+}
+
+LIFT(liftFdivD)
+{
+	return fp_set(il, 8, inst.rd, il.FloatDiv(8, fp_reg(il, 8, inst.rs1), fp_reg(il, 8, inst.rs2)));
+}
+
+LIFT(liftFsqrtD)
+{
+	return fp_set(il, 8, inst.rd, il.FloatSqrt(8, fp_reg(il, 8, inst.rs1)));
+}
+
+LIFT(liftFsgnjD) { return fp_sign_inject(il, inst, 8, SignCopy); }
+LIFT(liftFsgnjnD) { return fp_sign_inject(il, inst, 8, SignNegate); }
+LIFT(liftFsgnjxD) { return fp_sign_inject(il, inst, 8, SignXor); }
+
+LIFT(liftFminD)
+{
+	return fp_intrinsic(il, fpRegister(inst.rd), IntrinsicFminD, { fp_reg(il, 8, inst.rs1), fp_reg(il, 8, inst.rs2) });
+}
+
+LIFT(liftFmaxD)
+{
+	return fp_intrinsic(il, fpRegister(inst.rd), IntrinsicFmaxD, { fp_reg(il, 8, inst.rs1), fp_reg(il, 8, inst.rs2) });
+}
+
+LIFT(liftFcvtSD)
+{
+	return fp_set(il, 4, inst.rd, il.FloatConvert(4, fp_reg(il, 8, inst.rs1)));
+}
+
+LIFT(liftFcvtDS)
+{
+	return fp_set(il, 8, inst.rd, il.FloatConvert(8, fp_reg(il, 4, inst.rs1)));
+}
+
+LIFT(liftFeqD)
+{
+	return il.SetRegister(RegSize, inst.rd,
+		il.BoolToInt(RegSize, il.FloatCompareEqual(8, fp_reg(il, 8, inst.rs1), fp_reg(il, 8, inst.rs2))));
+}
+
+LIFT(liftFltD)
+{
+	return il.SetRegister(RegSize, inst.rd,
+		il.BoolToInt(RegSize, il.FloatCompareLessThan(8, fp_reg(il, 8, inst.rs1), fp_reg(il, 8, inst.rs2))));
+}
+
+LIFT(liftFleD)
+{
+	return il.SetRegister(RegSize, inst.rd,
+		il.BoolToInt(RegSize, il.FloatCompareLessEqual(8, fp_reg(il, 8, inst.rs1), fp_reg(il, 8, inst.rs2))));
+}
+
+LIFT(liftFclassD)
+{
+	return fp_intrinsic(il, inst.rd, IntrinsicFclassD, { fp_reg(il, 8, inst.rs1) });
+}
+
+LIFT(liftFcvtWD) { return fp_to_int<RegSize>(il, inst, 8, 4); }
+LIFT(liftFcvtWuD) { return fp_intrinsic(il, inst.rd, IntrinsicFcvtWuD, { fp_reg(il, 8, inst.rs1) }); }
+LIFT(liftFcvtLD) { return fp_to_int<RegSize>(il, inst, 8, 8); }
+LIFT(liftFcvtLuD) { return fp_intrinsic(il, inst.rd, IntrinsicFcvtLuD, { fp_reg(il, 8, inst.rs1) }); }
+
+LIFT(liftFmvXD)
+{
+	return il.SetRegister(RegSize, inst.rd, fp_reg(il, 8, inst.rs1));
+}
+
+LIFT(liftFcvtDW) { return int_to_fp<RegSize>(il, inst, 8, 4, false); }
+LIFT(liftFcvtDWu) { return int_to_fp<RegSize>(il, inst, 8, 4, true); }
+LIFT(liftFcvtDL) { return int_to_fp<RegSize>(il, inst, 8, 8, false); }
+LIFT(liftFcvtDLu)
+{
+	return fp_intrinsic(il, fpRegister(inst.rd), IntrinsicFcvtDLu, { il.Register(8, inst.rs1) });
+}
+
+LIFT(liftFmvDX)
+{
+	return fp_set(il, 8, inst.rd, il.Register(RegSize, inst.rs1));
+}
+
+// lr is a plain load, the reservation it takes has no IL equivalent
+template <size_t RegSize>
+static ExprId load_reserved(BinaryNinja::LowLevelILFunction& il, Instruction& inst, size_t size)
+{
+	const ExprId value = il.Load(size, il.Register(RegSize, inst.rs1));
+	if (size == 4)
+		return il.SetRegister(RegSize, inst.rd, il.SignExtend(RegSize, value));
+	return il.SetRegister(RegSize, inst.rd, value);
+}
+
+template <size_t RegSize>
+static ExprId atomic_intrinsic(BinaryNinja::LowLevelILFunction& il, Instruction& inst, size_t size,
+	Intrinsic intrinsic)
+{
+	std::vector<RegisterOrFlag> outputs;
+	if (inst.rd != Registers::Zero)
+		outputs.push_back(RegisterOrFlag::Register(inst.rd));
+	return il.Intrinsic(outputs, intrinsic, { il.Register(RegSize, inst.rs1), il.Register(size, inst.rs2) });
+}
+
+enum AtomicOp {
+	AtomicSwap,
+	AtomicAdd,
+	AtomicXor,
+	AtomicAnd,
+	AtomicOr
+};
+
+// AMOs with an LLIL equivalent are lifted as the read-modify-write they
+// perform. The old value goes through a temporary so rd may alias rs1 or rs2.
+template <size_t RegSize>
+static ExprId atomic_op(BinaryNinja::LowLevelILFunction& il, Instruction& inst, size_t size, AtomicOp op)
+{
+	const uint32_t old = LLIL_TEMP(0);
+	il.AddInstruction(il.SetRegister(size, old, il.Load(size, il.Register(RegSize, inst.rs1))));
+
+	const ExprId src = il.Register(size, inst.rs2);
+	ExprId value;
+	switch (op) {
+	case AtomicSwap:
+		value = src;
 		break;
-	case RET:
-		expr = il.Return(il.Register(8, inst.rs1));
+	case AtomicAdd:
+		value = il.Add(size, il.Register(size, old), src);
 		break;
-	case MV:
-		expr = il.SetRegister(8, inst.rd, il.Register(8, inst.rs1));
+	case AtomicXor:
+		value = il.Xor(size, il.Register(size, old), src);
 		break;
-	case JR:
-		expr = il.Jump(il.Register(8, inst.rs1));
+	case AtomicAnd:
+		value = il.And(size, il.Register(size, old), src);
 		break;
 	default:
+		value = il.Or(size, il.Register(size, old), src);
 		break;
 	}
+	il.AddInstruction(il.Store(size, il.Register(RegSize, inst.rs1), value));
+
+	if (inst.rd == Registers::Zero)
+		return il.Nop();
+	if (size == 4)
+		return il.SetRegister(RegSize, inst.rd, il.SignExtend(RegSize, il.Register(4, old)));
+	return il.SetRegister(RegSize, inst.rd, il.Register(RegSize, old));
+}
+
+LIFT(liftLrW) { return load_reserved<RegSize>(il, inst, 4); }
+LIFT(liftScW) { return atomic_intrinsic<RegSize>(il, inst, 4, IntrinsicScW); }
+LIFT(liftAmoswapW) { return atomic_op<RegSize>(il, inst, 4, AtomicSwap); }
+LIFT(liftAmoaddW) { return atomic_op<RegSize>(il, inst, 4, AtomicAdd); }
+LIFT(liftAmoxorW) { return atomic_op<RegSize>(il, inst, 4, AtomicXor); }
+LIFT(liftAmoandW) { return atomic_op<RegSize>(il, inst, 4, AtomicAnd); }
+LIFT(liftAmoorW) { return atomic_op<RegSize>(il, inst, 4, AtomicOr); }
+LIFT(liftAmominW) { return atomic_intrinsic<RegSize>(il, inst, 4, IntrinsicAmominW); }
+LIFT(liftAmomaxW) { return atomic_intrinsic<RegSize>(il, inst, 4, IntrinsicAmomaxW); }
+LIFT(liftAmominuW) { return atomic_intrinsic<RegSize>(il, inst, 4, IntrinsicAmominuW); }
+LIFT(liftAmomaxuW) { return atomic_intrinsic<RegSize>(il, inst, 4, IntrinsicAmomaxuW); }
+
+LIFT(liftLrD) { return load_reserved<RegSize>(il, inst, 8); }
+LIFT(liftScD) { return atomic_intrinsic<RegSize>(il, inst, 8, IntrinsicScD); }
+LIFT(liftAmoswapD) { return atomic_op<RegSize>(il, inst, 8, AtomicSwap); }
+LIFT(liftAmoaddD) { return atomic_op<RegSize>(il, inst, 8, AtomicAdd); }
+LIFT(liftAmoxorD) { return atomic_op<RegSize>(il, inst, 8, AtomicXor); }
+LIFT(liftAmoandD) { return atomic_op<RegSize>(il, inst, 8, AtomicAnd); }
+LIFT(liftAmoorD) { return atomic_op<RegSize>(il, inst, 8, AtomicOr); }
+LIFT(liftAmominD) { return atomic_intrinsic<RegSize>(il, inst, 8, IntrinsicAmominD); }
+LIFT(liftAmomaxD) { return atomic_intrinsic<RegSize>(il, inst, 8, IntrinsicAmomaxD); }
+LIFT(liftAmominuD) { return atomic_intrinsic<RegSize>(il, inst, 8, IntrinsicAmominuD); }
+LIFT(liftAmomaxuD) { return atomic_intrinsic<RegSize>(il, inst, 8, IntrinsicAmomaxuD); }
+
+// csrrw, csrrs and csrrc and their immediate forms. Writing x0 drops the
+// old value, which is how the csrw, csrs and csrc pseudo-instructions work.
+template <size_t RegSize>
+static ExprId csr_access(BinaryNinja::LowLevelILFunction& il, Instruction& inst, Intrinsic intrinsic,
+	bool immediate)
+{
+	std::vector<RegisterOrFlag> outputs;
+	if (inst.rd != Registers::Zero)
+		outputs.push_back(RegisterOrFlag::Register(inst.rd));
+	const ExprId value = immediate ? il.Const(RegSize, inst.rs1) : il.Register(RegSize, inst.rs1);
+	return il.Intrinsic(outputs, intrinsic, { il.Const(4, inst.csr()), value });
+}
+
+// sret and mret return to the address saved in sepc or mepc
+template <size_t RegSize>
+static ExprId trap_return(BinaryNinja::LowLevelILFunction& il, uint32_t csr)
+{
+	il.AddInstruction(il.Intrinsic({ RegisterOrFlag::Register(LLIL_TEMP(0)) }, IntrinsicCsrr,
+		{ il.Const(4, csr) }));
+	return il.Return(il.Register(RegSize, LLIL_TEMP(0)));
+}
+
+LIFT(liftCsrr)
+{
+	// Reading into x0 still has the side effects of reading the CSR
+	std::vector<RegisterOrFlag> outputs;
+	if (inst.rd != Registers::Zero)
+		outputs.push_back(RegisterOrFlag::Register(inst.rd));
+	return il.Intrinsic(outputs, IntrinsicCsrr, { il.Const(4, inst.csr()) });
+}
+
+LIFT(liftCsrrw) { return csr_access<RegSize>(il, inst, IntrinsicCsrrw, false); }
+LIFT(liftCsrrs) { return csr_access<RegSize>(il, inst, IntrinsicCsrrs, false); }
+LIFT(liftCsrrc) { return csr_access<RegSize>(il, inst, IntrinsicCsrrc, false); }
+LIFT(liftCsrrwi) { return csr_access<RegSize>(il, inst, IntrinsicCsrrw, true); }
+LIFT(liftCsrrsi) { return csr_access<RegSize>(il, inst, IntrinsicCsrrs, true); }
+LIFT(liftCsrrci) { return csr_access<RegSize>(il, inst, IntrinsicCsrrc, true); }
+
+LIFT(liftSret) { return trap_return<RegSize>(il, CsrSepc); }
+LIFT(liftMret) { return trap_return<RegSize>(il, CsrMepc); }
+
+LIFT(liftWfi)
+{
+	return il.Intrinsic({}, IntrinsicWfi, {});
+}
+
+LIFT(liftSfenceVma)
+{
+	return il.Intrinsic({}, IntrinsicSfenceVma, { il.Register(RegSize, inst.rs1), il.Register(RegSize, inst.rs2) });
+}
+
+#undef LIFT
+
+typedef ExprId (*LiftFunction)(Architecture* arch, BinaryNinja::LowLevelILFunction& il,
+	Instruction& inst, uint64_t addr);
+
+template <size_t RegSize>
+static const LiftFunction liftFunctions[] = {
+#define INSTR(id, mnemonic, mask, match, format, operands, lift) lift<RegSize>,
+#include "instructions.def"
+#undef INSTR
+};
+
+template <size_t RegSize>
+void liftToLowLevelIL(Architecture* arch, const uint8_t* data, uint64_t addr, size_t& len,
+	BinaryNinja::LowLevelILFunction& il)
+{
+	RISCV_TRACE_SCOPE("liftToLowLevelIL", addr);
+	Instruction inst = DecodeCache::decode<RegSize * 8>(data, addr, len);
+	ExprId expr = il.Unimplemented();
+	if (inst.mnemonic != InstrName::UNSUPPORTED)
+		expr = liftFunctions<RegSize>[inst.mnemonic](arch, il, inst, addr);
 	il.AddInstruction(expr);
+	len = inst.size;
 }
+
+template void liftToLowLevelIL<4>(Architecture* arch, const uint8_t* data, uint64_t addr, size_t& len,
+	BinaryNinja::LowLevelILFunction& il);
+template void liftToLowLevelIL<8>(Architecture* arch, const uint8_t* data, uint64_t addr, size_t& len,
+	BinaryNinja::LowLevelILFunction& il);
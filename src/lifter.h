@@ -6,12 +6,25 @@
 
 using namespace BinaryNinja;
 
-ExprId store_helper(BinaryNinja::LowLevelILFunction& il, Instruction& inst,
-	uint64_t size);
+enum IntrinsicType {
+	IntrinsicNone,
+	Int32,
+	Int64,
+	// As wide as the registers
+	IntXlen,
+	Float32,
+	Float64
+};
 
-ExprId load_helper(BinaryNinja::LowLevelILFunction& il, Instruction& inst,
-	uint64_t size, bool isUnsigned);
+enum Intrinsic : uint32_t {
+#define INTRINSIC(id, name, input1, input2, output) Intrinsic##id,
+#include "intrinsics.def"
+#undef INTRINSIC
+	INTRINSIC_COUNT
+};
 
+// RegSize is XLEN in bytes, 4 for RV32 and 8 for RV64
+template <size_t RegSize>
 void liftToLowLevelIL(Architecture* arch, const uint8_t* data, uint64_t addr, size_t& len,
 	BinaryNinja::LowLevelILFunction& il);
 
@@ -0,0 +1,215 @@
+#include "profiler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cinttypes>
+#include <cstdarg>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace {
+// Values below 16 get a bucket each, every power of two above is split into
+// 16 sub-buckets
+constexpr unsigned SubBits = 4;
+constexpr size_t SubCount = 1 << SubBits;
+constexpr size_t BucketCount = (64 - SubBits + 1) * SubCount;
+constexpr size_t OpcodeCount = 128;
+
+const char* const probeNames[] = {
+	"GetInstructionInfo",
+	"GetInstructionText",
+	"GetInstructionLowLevelIL",
+	"disasm"
+};
+
+static_assert(sizeof(probeNames) / sizeof(probeNames[0]) == Profiler::PROBE_COUNT,
+	"every probe needs a name");
+
+unsigned highestBit(uint64_t value)
+{
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanReverse64(&index, value);
+	return index;
+#else
+	return 63 - __builtin_clzll(value);
+#endif
+}
+
+size_t bucketIndex(uint64_t value)
+{
+	if (value < SubCount)
+		return value;
+	const unsigned exponent = highestBit(value);
+	const size_t sub = (value >> (exponent - SubBits)) & (SubCount - 1);
+	return (exponent - SubBits + 1) * SubCount + sub;
+}
+
+// Smallest value that falls into the bucket
+uint64_t bucketValue(size_t index)
+{
+	if (index < SubCount)
+		return index;
+	const unsigned exponent = index / SubCount + SubBits - 1;
+	return (uint64_t)(SubCount + index % SubCount) << (exponent - SubBits);
+}
+
+// Counters are only written by the thread that owns them, so a relaxed
+// load and store is enough and readers see a recent value
+void bump(std::atomic<uint64_t>& counter, uint64_t amount = 1)
+{
+	counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+}
+
+struct ProbeStats {
+	std::atomic<uint64_t> buckets[BucketCount] {};
+	std::atomic<uint64_t> calls { 0 };
+	std::atomic<uint64_t> totalNs { 0 };
+	std::atomic<uint64_t> maxNs { 0 };
+};
+
+struct ThreadStats {
+	ProbeStats probes[Profiler::PROBE_COUNT];
+	std::atomic<uint64_t> mnemonics[INSTR_COUNT] {};
+	std::atomic<uint64_t> undecodable[OpcodeCount] {};
+};
+
+std::mutex registryLock;
+// Kept after their thread exits so its counts stay in the report
+std::vector<std::unique_ptr<ThreadStats>> registry;
+
+ThreadStats& threadStats()
+{
+	static thread_local ThreadStats* stats = nullptr;
+	if (!stats) {
+		std::lock_guard<std::mutex> guard(registryLock);
+		registry.push_back(std::make_unique<ThreadStats>());
+		stats = registry.back().get();
+	}
+	return *stats;
+}
+
+uint64_t load(const std::atomic<uint64_t>& counter)
+{
+	return counter.load(std::memory_order_relaxed);
+}
+
+void appendf(std::string& out, const char* fmt, ...)
+{
+	char buf[256];
+	va_list args;
+	va_start(args, fmt);
+	vsnprintf(buf, sizeof(buf), fmt, args);
+	va_end(args);
+	out += buf;
+}
+
+uint64_t percentile(const std::vector<uint64_t>& buckets, uint64_t calls, double fraction)
+{
+	const uint64_t rank = (uint64_t)(calls * fraction);
+	uint64_t seen = 0;
+	for (size_t i = 0; i < BucketCount; i++) {
+		seen += buckets[i];
+		if (seen > rank)
+			return bucketValue(i);
+	}
+	return 0;
+}
+}
+
+void Profiler::recordLatency(Probe probe, uint64_t nanoseconds)
+{
+	ProbeStats& stats = threadStats().probes[probe];
+	bump(stats.buckets[bucketIndex(nanoseconds)]);
+	bump(stats.calls);
+	bump(stats.totalNs, nanoseconds);
+	if (nanoseconds > load(stats.maxNs))
+		stats.maxNs.store(nanoseconds, std::memory_order_relaxed);
+}
+
+void Profiler::recordDecode(const Instruction& instr, uint32_t insword)
+{
+	ThreadStats& stats = threadStats();
+	if (instr.type == InstrType::Error)
+		bump(stats.undecodable[insword & 0x7f]);
+	else
+		bump(stats.mnemonics[instr.mnemonic]);
+}
+
+std::string Profiler::report()
+{
+	std::lock_guard<std::mutex> guard(registryLock);
+
+	std::string out = "{\n  \"threads\": ";
+	appendf(out, "%zu,\n  \"probes\": {", registry.size());
+	for (size_t probe = 0; probe < PROBE_COUNT; probe++) {
+		std::vector<uint64_t> buckets(BucketCount);
+		uint64_t calls = 0, totalNs = 0, maxNs = 0;
+		for (const auto& stats : registry) {
+			const ProbeStats& probeStats = stats->probes[probe];
+			for (size_t i = 0; i < BucketCount; i++)
+				buckets[i] += load(probeStats.buckets[i]);
+			calls += load(probeStats.calls);
+			totalNs += load(probeStats.totalNs);
+			maxNs = std::max(maxNs, load(probeStats.maxNs));
+		}
+
+		appendf(out, "%s\n    \"%s\": { \"calls\": %" PRIu64 ", \"totalNs\": %" PRIu64 ", \"meanNs\": %" PRIu64,
+			probe ? "," : "", probeNames[probe], calls, totalNs, calls ? totalNs / calls : 0);
+		appendf(out, ", \"p50Ns\": %" PRIu64 ", \"p90Ns\": %" PRIu64 ", \"p99Ns\": %" PRIu64
+					 ", \"p999Ns\": %" PRIu64 ", \"maxNs\": %" PRIu64 " }",
+			percentile(buckets, calls, 0.5), percentile(buckets, calls, 0.9),
+			percentile(buckets, calls, 0.99), percentile(buckets, calls, 0.999), maxNs);
+	}
+
+	out += "\n  },\n  \"mnemonics\": {";
+	bool first = true;
+	for (size_t mnemonic = 0; mnemonic < INSTR_COUNT; mnemonic++) {
+		uint64_t count = 0;
+		for (const auto& stats : registry)
+			count += load(stats->mnemonics[mnemonic]);
+		if (count == 0)
+			continue;
+		appendf(out, "%s\n    \"%s\": %" PRIu64, first ? "" : ",", instrNames[mnemonic], count);
+		first = false;
+	}
+
+	out += "\n  },\n  \"undecodableOpcodes\": {";
+	first = true;
+	for (size_t opcode = 0; opcode < OpcodeCount; opcode++) {
+		uint64_t count = 0;
+		for (const auto& stats : registry)
+			count += load(stats->undecodable[opcode]);
+		if (count == 0)
+			continue;
+		appendf(out, "%s\n    \"0x%02zx\": %" PRIu64, first ? "" : ",", opcode, count);
+		first = false;
+	}
+	out += "\n  }\n}\n";
+	return out;
+}
+
+void Profiler::reset()
+{
+	// Racing with a thread that is recording may keep one of its updates
+	std::lock_guard<std::mutex> guard(registryLock);
+	for (const auto& stats : registry) {
+		for (ProbeStats& probe : stats->probes) {
+			for (auto& bucket : probe.buckets)
+				bucket.store(0, std::memory_order_relaxed);
+			probe.calls.store(0, std::memory_order_relaxed);
+			probe.totalNs.store(0, std::memory_order_relaxed);
+			probe.maxNs.store(0, std::memory_order_relaxed);
+		}
+		for (auto& count : stats->mnemonics)
+			count.store(0, std::memory_order_relaxed);
+		for (auto& count : stats->undecodable)
+			count.store(0, std::memory_order_relaxed);
+	}
+}
@@ -0,0 +1,69 @@
+#ifndef BN_RISCV_ARCH_PROFILER_H
+#define BN_RISCV_ARCH_PROFILER_H
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+#include "disassembler.h"
+
+// Opt-in latency and decode statistics for telling slow plugin callbacks
+// apart from slow core analysis. Build with BN_RISCV_PROFILE to enable it,
+// otherwise the RISCV_PROFILE_* macros expand to nothing.
+//
+// Every thread records into its own counters, so recording takes no locks
+// and no atomic read-modify-writes. Latencies go into log-linear histograms
+// with 16 sub-buckets per power of two, which keeps percentiles within
+// about 6% of the true value.
+class Profiler {
+public:
+	enum Probe {
+		ProbeInstructionInfo,
+		ProbeInstructionText,
+		ProbeLowLevelIL,
+		ProbeDisasm,
+		PROBE_COUNT
+	};
+
+	static void recordLatency(Probe probe, uint64_t nanoseconds);
+
+	// Counts a decode by mnemonic, or by major opcode when insword is undecodable
+	static void recordDecode(const Instruction& instr, uint32_t insword);
+
+	// Statistics of every thread merged into a JSON object
+	static std::string report();
+
+	static void reset();
+};
+
+// Records the time until the end of the enclosing scope against a probe
+class ProfileScope {
+	Profiler::Probe probe;
+	std::chrono::steady_clock::time_point start;
+
+public:
+	explicit ProfileScope(Profiler::Probe probe_)
+		: probe(probe_)
+		, start(std::chrono::steady_clock::now())
+	{
+	}
+
+	~ProfileScope()
+	{
+		const auto elapsed = std::chrono::steady_clock::now() - start;
+		Profiler::recordLatency(probe, std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+	}
+
+	ProfileScope(const ProfileScope&) = delete;
+	ProfileScope& operator=(const ProfileScope&) = delete;
+};
+
+#ifdef BN_RISCV_PROFILE
+#define RISCV_PROFILE_SCOPE(probe) ProfileScope profileScope(Profiler::probe)
+#define RISCV_PROFILE_DECODE(instr, insword) Profiler::recordDecode(instr, insword)
+#else
+#define RISCV_PROFILE_SCOPE(probe)
+#define RISCV_PROFILE_DECODE(instr, insword)
+#endif
+
+#endif // BN_RISCV_ARCH_PROFILER_H
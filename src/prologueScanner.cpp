@@ -0,0 +1,146 @@
+#include "prologueScanner.h"
+#include "compressed.h"
+#include "disassembler.h"
+#include "fetch.h"
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+namespace {
+// Instructions after a frame allocation searched for the save of ra
+constexpr int SaveWindow = 4;
+
+// Decodes the instruction at offset without reporting undecodable words,
+// which are expected in data mixed into code
+template <unsigned Xlen>
+bool fetch(const uint8_t* data, size_t len, size_t offset, Instruction& out)
+{
+	const size_t size = Fetch::length(data + offset, len - offset);
+	if (size == 0)
+		return false;
+
+	if (size == 2) {
+		const uint16_t parcel = Fetch::parcel(data + offset);
+		const uint32_t expanded = Xlen == 32 ? Compressed::expand32(parcel) : Compressed::expand(parcel);
+		if (expanded == 0)
+			return false;
+		out = Disassembler::decode<Xlen>(expanded);
+		out.size = 2;
+	} else
+		out = Disassembler::decode<Xlen>(Fetch::word(data + offset));
+	return out.type != InstrType::Error;
+}
+
+bool allocatesFrame(const Instruction& instr)
+{
+	return instr.mnemonic == InstrName::ADDI && instr.rd == Registers::sp && instr.rs1 == Registers::sp
+		&& instr.imm < 0;
+}
+
+bool savesRa(const Instruction& instr)
+{
+	return (instr.mnemonic == InstrName::SD || instr.mnemonic == InstrName::SW)
+		&& instr.rs1 == Registers::sp && instr.rs2 == Registers::ra;
+}
+
+template <unsigned Xlen>
+bool isPrologue(const uint8_t* data, size_t len, size_t offset, const Instruction& first)
+{
+	if (!allocatesFrame(first))
+		return false;
+
+	Instruction instr;
+	offset += first.size;
+	for (int i = 0; i < SaveWindow && fetch<Xlen>(data, len, offset, instr); i++) {
+		if (savesRa(instr))
+			return true;
+		if (Disassembler::isControlFlow(instr.mnemonic))
+			break;
+		offset += instr.size;
+	}
+	return false;
+}
+
+// Sweeps [start, end) of data, reading past end only to complete the
+// patterns that begin inside it
+template <unsigned Xlen>
+void scanChunk(const uint8_t* data, size_t len, uint64_t base, size_t start, size_t end,
+	std::vector<uint64_t>& out)
+{
+	bool auipcKnown = false;
+	uint32_t auipcReg = 0;
+	uint64_t auipcValue = 0;
+
+	Instruction instr;
+	for (size_t offset = start; offset < end;) {
+		if (!fetch<Xlen>(data, len, offset, instr)) {
+			auipcKnown = false;
+			offset += 2;
+			continue;
+		}
+
+		const uint64_t addr = base + offset;
+		uint64_t target = 0;
+		if (isPrologue<Xlen>(data, len, offset, instr))
+			out.push_back(addr);
+		else if (instr.mnemonic == InstrName::JAL && Disassembler::flowKind(instr) == FlowCall)
+			target = targetAddr<Xlen>(addr, instr.imm);
+		else if (instr.mnemonic == InstrName::JALR && auipcKnown && instr.rs1 == auipcReg
+			&& Disassembler::flowKind(instr) == FlowIndirectCall)
+			target = targetAddr<Xlen>(auipcValue, instr.imm);
+
+		// Only targets inside the region that start with a valid instruction
+		Instruction callee;
+		if (target >= base && target < base + len && !(target & 1)
+			&& fetch<Xlen>(data, len, target - base, callee))
+			out.push_back(target);
+
+		auipcKnown = instr.mnemonic == InstrName::AUIPC && instr.rd != Registers::Zero;
+		if (auipcKnown) {
+			auipcReg = instr.rd;
+			auipcValue = addr + (int64_t)(int32_t)((uint32_t)instr.imm << 12);
+		}
+		offset += instr.size;
+	}
+}
+}
+
+template <unsigned Xlen>
+std::vector<uint64_t> PrologueScanner::scan(const uint8_t* data, size_t len, uint64_t base,
+	unsigned threads)
+{
+	const size_t chunks = (len + ChunkSize - 1) / ChunkSize;
+	if (threads == 0)
+		threads = std::max(1u, std::thread::hardware_concurrency());
+	threads = (unsigned)std::min<size_t>(threads, chunks);
+
+	std::vector<std::vector<uint64_t>> found(threads);
+	std::atomic<size_t> next { 0 };
+	auto worker = [&](unsigned id) {
+		for (size_t chunk; (chunk = next++) < chunks;) {
+			const size_t start = chunk * ChunkSize;
+			scanChunk<Xlen>(data, len, base, start, std::min(len, start + ChunkSize), found[id]);
+		}
+	};
+
+	std::vector<std::thread> workers;
+	for (unsigned i = 1; i < threads; i++)
+		workers.emplace_back(worker, i);
+	if (threads > 0)
+		worker(0);
+	for (std::thread& thread : workers)
+		thread.join();
+
+	std::vector<uint64_t> result;
+	for (const std::vector<uint64_t>& candidates : found)
+		result.insert(result.end(), candidates.begin(), candidates.end());
+	std::sort(result.begin(), result.end());
+	result.erase(std::unique(result.begin(), result.end()), result.end());
+	return result;
+}
+
+template std::vector<uint64_t> PrologueScanner::scan<32>(const uint8_t* data, size_t len, uint64_t base,
+	unsigned threads);
+template std::vector<uint64_t> PrologueScanner::scan<64>(const uint8_t* data, size_t len, uint64_t base,
+	unsigned threads);
@@ -0,0 +1,26 @@
+#ifndef BN_RISCV_ARCH_PROLOGUESCANNER_H
+#define BN_RISCV_ARCH_PROLOGUESCANNER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Finds likely function starts in executable code that nothing calls
+// visibly, such as stripped firmware. The code is split into chunks that
+// are swept in parallel looking for:
+//   - a stack frame allocation (addi sp, sp, -N or c.addi16sp) followed by a
+//     save of ra (sd/sw ra, off(sp) or c.sdsp/c.swsp)
+//   - targets of jal ra and auipc+jalr call sequences
+class PrologueScanner {
+public:
+	static constexpr size_t ChunkSize = 256 * 1024;
+
+	// Returns the sorted candidate addresses in [base, base + len). threads is
+	// the number of worker threads, 0 for one per core. Xlen selects RV32 or
+	// RV64 decoding.
+	template <unsigned Xlen = 64>
+	static std::vector<uint64_t> scan(const uint8_t* data, size_t len, uint64_t base,
+		unsigned threads = 0);
+};
+
+#endif // BN_RISCV_ARCH_PROLOGUESCANNER_H
@@ -1,215 +1,140 @@
 #include "riscvArch.h"
 #include "binaryninjacore.h"
-#include "disassembler.h"
+#include "decodeCache.h"
+#include "formatter.h"
 #include "lifter.h"
+#include "profiler.h"
+#include "tracer.h"
 
-BNEndianness riscvArch::GetEndianness() const
+template <unsigned Xlen, BNEndianness Endian>
+BNEndianness riscvArch<Xlen, Endian>::GetEndianness() const
 {
-	return endian;
+	return Endian;
 }
 
-size_t riscvArch::GetAddressSize() const
+template <unsigned Xlen, BNEndianness Endian>
+size_t riscvArch<Xlen, Endian>::GetAddressSize() const
 {
-	return addressSize;
+	return RegSize;
 }
 
 // Responsible for disassembling instructions and feeding BN info for the CFG
-bool riscvArch::GetInstructionInfo(const uint8_t* data, uint64_t addr, size_t maxLen, BinaryNinja::InstructionInfo& result)
+template <unsigned Xlen, BNEndianness Endian>
+bool riscvArch<Xlen, Endian>::GetInstructionInfo(const uint8_t* data, uint64_t addr, size_t maxLen, BinaryNinja::InstructionInfo& result)
 {
-	const Instruction res = Disassembler::disasm(data, addr);
-	if (res.type == InstrType::Error || maxLen < 4) {
+	RISCV_PROFILE_SCOPE(ProbeInstructionInfo);
+	RISCV_TRACE_SCOPE("GetInstructionInfo", addr);
+	const Instruction res = DecodeCache::decode<Xlen>(data, addr, maxLen);
+	if (res.type == InstrType::Error || maxLen < res.size) {
 		result.length = 0;
 		return false;
 	}
 
-	// Check for branches
-	switch (res.mnemonic) {
-	case InstrName::BEQ:
-	case InstrName::BNE:
-	case InstrName::BLT:
-	case InstrName::BGE:
-	case InstrName::BLTU:
-	case InstrName::BGEU:
-		result.AddBranch(BNBranchType::TrueBranch, res.imm + addr);
-		result.AddBranch(BNBranchType::FalseBranch, addr + 4);
+	switch (Disassembler::flowKind(res)) {
+	case FlowConditionalBranch:
+		result.AddBranch(BNBranchType::TrueBranch, targetAddr<Xlen>(addr, res.imm));
+		result.AddBranch(BNBranchType::FalseBranch, targetAddr<Xlen>(addr, res.size));
 		break;
-	case InstrName::J:
-		result.AddBranch(BNBranchType::UnconditionalBranch, res.imm);
+	case FlowJump:
+		result.AddBranch(BNBranchType::UnconditionalBranch, targetAddr<Xlen>(addr, res.imm));
 		break;
-	case InstrName::RET:
+	case FlowCall:
+		result.AddBranch(BNBranchType::CallDestination, targetAddr<Xlen>(addr, res.imm));
+		break;
+	case FlowReturn:
 		result.AddBranch(BNBranchType::FunctionReturn);
 		break;
+	case FlowIndirectJump:
+		result.AddBranch(BNBranchType::UnresolvedBranch);
+		break;
 	default:
+		// Indirect calls return to the next instruction like any other
 		break;
 	}
 
-	result.length = 4;
+	result.length = res.size;
 	return true;
 }
 
+static BNInstructionTextTokenType tokenType(TokenType type)
+{
+	switch (type) {
+	case TokenType::Instruction:
+		return BNInstructionTextTokenType::InstructionToken;
+	case TokenType::OperandSeparator:
+		return BNInstructionTextTokenType::OperandSeparatorToken;
+	case TokenType::Register:
+		return BNInstructionTextTokenType::RegisterToken;
+	case TokenType::Integer:
+		return BNInstructionTextTokenType::IntegerToken;
+	case TokenType::PossibleAddress:
+		return BNInstructionTextTokenType::PossibleAddressToken;
+	case TokenType::CodeRelativeAddress:
+		return BNInstructionTextTokenType::CodeRelativeAddressToken;
+	case TokenType::Keyword:
+		return BNInstructionTextTokenType::KeywordToken;
+	default:
+		return BNInstructionTextTokenType::TextToken;
+	}
+}
+
 // Provides the text that BN displays for disassembly view
-bool riscvArch::GetInstructionText(const uint8_t* data, uint64_t addr, size_t& len,
+template <unsigned Xlen, BNEndianness Endian>
+bool riscvArch<Xlen, Endian>::GetInstructionText(const uint8_t* data, uint64_t addr, size_t& len,
 	std::vector<BinaryNinja::InstructionTextToken>& result)
 {
-	const Instruction res = Disassembler::disasm(data, addr);
+	RISCV_PROFILE_SCOPE(ProbeInstructionText);
+	const Instruction res = DecodeCache::decode<Xlen>(data, addr, len);
 	if (res.type == InstrType::Error) {
 		len = 0;
 		return false;
 	}
 
-#define PADDING_SIZE 6
-	char padding[PADDING_SIZE + 1];
-	memset(padding, 0x20, sizeof(padding));
-	const size_t mnemonicLen = strlen(instrNames[res.mnemonic]);
-	if (mnemonicLen < PADDING_SIZE) {
-		padding[PADDING_SIZE - mnemonicLen] = '\0';
-	} else
-		padding[PADDING_SIZE] = '\0';
+	TokenList tokens;
+	Formatter::render<Xlen>(res, addr, tokens);
+	result.reserve(result.size() + tokens.size());
+	for (const Token& token : tokens)
+		result.emplace_back(tokenType(token.type), std::string(token.text, token.length), token.value);
 
-	result.emplace_back(BNInstructionTextTokenType::InstructionToken, instrNames[res.mnemonic]);
-	result.emplace_back(BNInstructionTextTokenType::TextToken, padding);
-	result.emplace_back(BNInstructionTextTokenType::TextToken, " ");
-
-	switch (res.type) {
-	case Rtype: {
-		result.emplace_back(BNInstructionTextTokenType::RegisterToken, registerNames[res.rd]);
-		result.emplace_back(BNInstructionTextTokenType::OperandSeparatorToken, ", ");
-		result.emplace_back(BNInstructionTextTokenType::RegisterToken, registerNames[res.rs1]);
-		result.emplace_back(BNInstructionTextTokenType::OperandSeparatorToken, ", ");
-
-		if (res.mnemonic == InstrName::SLLIW || res.mnemonic == InstrName::SLLI || res.mnemonic == InstrName::SRLI || res.mnemonic == InstrName::SRLIW || res.mnemonic == InstrName::SRAI || res.mnemonic == InstrName::SRAIW)
-			result.emplace_back(BNInstructionTextTokenType::IntegerToken, std::to_string(res.rs2));
-		else
-			result.emplace_back(BNInstructionTextTokenType::RegisterToken, registerNames[res.rs2]);
-		break;
-	}
-	case Itype: {
-		switch (res.mnemonic) {
-		case InstrName::RET:
-			// ret pseudo-instruction
-			break;
-		case InstrName::LI:
-			// li pseudo-instruction
-			result.emplace_back(BNInstructionTextTokenType::RegisterToken, registerNames[res.rd]);
-			result.emplace_back(BNInstructionTextTokenType::OperandSeparatorToken, ", ");
-			result.emplace_back(BNInstructionTextTokenType::IntegerToken, std::to_string(res.imm));
-			break;
-		case InstrName::LB:
-		case InstrName::LH:
-		case InstrName::LW:
-		case InstrName::LBU:
-		case InstrName::LHU:
-		case InstrName::LWU:
-		case InstrName::LD:
-			result.emplace_back(BNInstructionTextTokenType::RegisterToken, registerNames[res.rd]);
-			result.emplace_back(BNInstructionTextTokenType::OperandSeparatorToken, ", ");
-			result.emplace_back(BNInstructionTextTokenType::CodeRelativeAddressToken, std::to_string(res.imm));
-			result.emplace_back(BNInstructionTextTokenType::OperandSeparatorToken, "(");
-			result.emplace_back(BNInstructionTextTokenType::RegisterToken, registerNames[res.rs1]);
-			result.emplace_back(BNInstructionTextTokenType::TextToken, ")");
-			break;
-		case InstrName::JR:
-			result.emplace_back(BNInstructionTextTokenType::RegisterToken, registerNames[res.rs1]);
-			break;
-		case InstrName::JALR: {
-			result.emplace_back(BNInstructionTextTokenType::RegisterToken, registerNames[res.rd]);
-			result.emplace_back(BNInstructionTextTokenType::OperandSeparatorToken, ", ");
-			result.emplace_back(BNInstructionTextTokenType::CodeRelativeAddressToken, std::to_string(res.imm));
-			result.emplace_back(BNInstructionTextTokenType::OperandSeparatorToken, "(");
-			result.emplace_back(BNInstructionTextTokenType::RegisterToken, registerNames[res.rs1]);
-			result.emplace_back(BNInstructionTextTokenType::TextToken, ")");
-			break;
-		}
-		case InstrName::MV:
-			result.emplace_back(BNInstructionTextTokenType::RegisterToken, registerNames[res.rd]);
-			result.emplace_back(BNInstructionTextTokenType::OperandSeparatorToken, ", ");
-			result.emplace_back(BNInstructionTextTokenType::RegisterToken, registerNames[res.rs1]);
-			break;
-		case InstrName::ECALL:
-		case InstrName::EBREAK:
-		case InstrName::FENCE:
-			break;
-		default:
-			result.emplace_back(BNInstructionTextTokenType::RegisterToken, registerNames[res.rd]);
-			result.emplace_back(BNInstructionTextTokenType::OperandSeparatorToken, ", ");
-			result.emplace_back(BNInstructionTextTokenType::RegisterToken, registerNames[res.rs1]);
-			result.emplace_back(BNInstructionTextTokenType::OperandSeparatorToken, ", ");
-			result.emplace_back(BNInstructionTextTokenType::IntegerToken, std::to_string(res.imm));
-			break;
-		}
-		break;
-	}
-	case Stype: {
-		result.emplace_back(BNInstructionTextTokenType::RegisterToken, registerNames[res.rs2]);
-		result.emplace_back(BNInstructionTextTokenType::OperandSeparatorToken, ", ");
-		result.emplace_back(BNInstructionTextTokenType::CodeRelativeAddressToken, std::to_string(res.imm));
-		result.emplace_back(BNInstructionTextTokenType::OperandSeparatorToken, "(");
-		result.emplace_back(BNInstructionTextTokenType::RegisterToken, registerNames[res.rs1]);
-		result.emplace_back(BNInstructionTextTokenType::TextToken, ")");
-		break;
-	}
-	case Btype: {
-		char buf[32];
-		snprintf(buf, sizeof(buf), "0x%llx", res.imm + addr);
-
-		result.emplace_back(BNInstructionTextTokenType::RegisterToken, registerNames[res.rs1]);
-		result.emplace_back(BNInstructionTextTokenType::OperandSeparatorToken, ", ");
-		result.emplace_back(BNInstructionTextTokenType::RegisterToken, registerNames[res.rs2]);
-		result.emplace_back(BNInstructionTextTokenType::OperandSeparatorToken, ", ");
-		result.emplace_back(BNInstructionTextTokenType::PossibleAddressToken, buf);
-		break;
-	}
-	case Utype: {
-		result.emplace_back(BNInstructionTextTokenType::RegisterToken, registerNames[res.rd]);
-		result.emplace_back(BNInstructionTextTokenType::OperandSeparatorToken, ", ");
-		result.emplace_back(BNInstructionTextTokenType::IntegerToken, std::to_string(res.imm));
-		break;
-	}
-	case Jtype: {
-		char buf[32];
-		snprintf(buf, sizeof(buf), "0x%llx", res.imm);
-		if (res.mnemonic != InstrName::J) {
-			result.emplace_back(BNInstructionTextTokenType::RegisterToken, registerNames[res.rd]);
-			result.emplace_back(BNInstructionTextTokenType::OperandSeparatorToken, ", ");
-		}
-		result.emplace_back(BNInstructionTextTokenType::PossibleAddressToken, buf, res.imm);
-		break;
-	}
-	case Error:
-		return false;
-	}
-	len = 4;
+	len = res.size;
 	return true;
 }
 
-bool riscvArch::GetInstructionLowLevelIL(const uint8_t* data, uint64_t addr, size_t& len,
+template <unsigned Xlen, BNEndianness Endian>
+bool riscvArch<Xlen, Endian>::GetInstructionLowLevelIL(const uint8_t* data, uint64_t addr, size_t& len,
 	BinaryNinja::LowLevelILFunction& il)
 {
-	liftToLowLevelIL(this, data, addr, len, il);
-	len = 4;
+	RISCV_PROFILE_SCOPE(ProbeLowLevelIL);
+	liftToLowLevelIL<RegSize>(this, data, addr, len, il);
 	return true;
 }
 
-std::vector<uint32_t> riscvArch::GetFullWidthRegisters()
+template <unsigned Xlen, BNEndianness Endian>
+std::vector<uint32_t> riscvArch<Xlen, Endian>::GetFullWidthRegisters()
 {
 	return GetAllRegisters();
 }
 
-std::vector<uint32_t> riscvArch::GetAllRegisters()
+template <unsigned Xlen, BNEndianness Endian>
+std::vector<uint32_t> riscvArch<Xlen, Endian>::GetAllRegisters()
 {
-	std::vector<uint32_t> result(32);
-	for (int i = 0; i < 32; ++i) {
-		result[i] = i;
-	}
+	std::vector<uint32_t> result;
+	result.reserve(32 + 33);
+	for (uint32_t i = Registers::Zero; i <= Registers::t6; ++i)
+		result.push_back(i);
+	for (uint32_t i = Registers::ft0; i <= Registers::fcsr; ++i)
+		result.push_back(i);
 	return result;
 }
 
-std::string riscvArch::GetRegisterStackName(uint32_t regStack)
+template <unsigned Xlen, BNEndianness Endian>
+std::string riscvArch<Xlen, Endian>::GetRegisterStackName(uint32_t regStack)
 {
 	return registerNames[Registers::sp];
 }
 
-BNRegisterInfo riscvArch::GetRegisterInfo(uint32_t reg)
+template <unsigned Xlen, BNEndianness Endian>
+BNRegisterInfo riscvArch<Xlen, Endian>::GetRegisterInfo(uint32_t reg)
 {
 	switch (reg) {
 	case Registers::Zero:
@@ -246,42 +171,59 @@ BNRegisterInfo riscvArch::GetRegisterInfo(uint32_t reg)
 	case Registers::t6:
 	case Registers::pc:
 		return RegisterInfo(reg);
+	case Registers::fcsr:
+		return RegisterInfo(reg, 4);
 	default:
+		// FP registers are 8 bytes wide, single-precision values use the low half
+		if (reg >= Registers::ft0 && reg <= Registers::ft11)
+			return RegisterInfo(reg, 8);
 		return RegisterInfo(0);
 	}
 }
 
-BNRegisterInfo riscvArch::RegisterInfo(uint32_t fullWidthReg)
+template <unsigned Xlen, BNEndianness Endian>
+BNRegisterInfo riscvArch<Xlen, Endian>::RegisterInfo(uint32_t fullWidthReg, size_t size)
 {
 	BNRegisterInfo result {};
 	result.fullWidthRegister = fullWidthReg;
 	result.offset = 0;
-	result.size = 8;
+	result.size = size;
 	result.extend = NoExtend;
 	return result;
 }
 
-uint32_t riscvArch::GetStackPointerRegister() { return Registers::sp; }
+template <unsigned Xlen, BNEndianness Endian>
+uint32_t riscvArch<Xlen, Endian>::GetStackPointerRegister() { return Registers::sp; }
 
-riscvArch::riscvArch(const std::string& name, BNEndianness endian_)
+template <unsigned Xlen, BNEndianness Endian>
+riscvArch<Xlen, Endian>::riscvArch(const std::string& name)
 	: Architecture(name)
 {
-	endian = endian_;
 }
 
-size_t riscvArch::GetDefaultIntegerSize() const
+template <unsigned Xlen, BNEndianness Endian>
+size_t riscvArch<Xlen, Endian>::GetDefaultIntegerSize() const
 {
-	return 8;
+	return RegSize;
 }
 
-size_t riscvArch::GetMaxInstructionLength() const
+template <unsigned Xlen, BNEndianness Endian>
+size_t riscvArch<Xlen, Endian>::GetMaxInstructionLength() const
 {
 	return 4;
 }
 
-std::string riscvArch::GetRegisterName(uint32_t reg)
+template <unsigned Xlen, BNEndianness Endian>
+size_t riscvArch<Xlen, Endian>::GetInstructionAlignment() const
+{
+	// RVC instructions only need 2-byte alignment
+	return 2;
+}
+
+template <unsigned Xlen, BNEndianness Endian>
+std::string riscvArch<Xlen, Endian>::GetRegisterName(uint32_t reg)
 {
-	if (reg < 33)
+	if (reg < sizeof(registerNames) / sizeof(registerNames[0]))
 		return { registerNames[reg] };
 	else {
 		std::string unReg("x");
@@ -290,4 +232,80 @@ std::string riscvArch::GetRegisterName(uint32_t reg)
 	}
 }
 
-uint32_t riscvArch::GetLinkRegister() { return Registers::ra; }
+template <unsigned Xlen, BNEndianness Endian>
+uint32_t riscvArch<Xlen, Endian>::GetLinkRegister() { return Registers::ra; }
+
+namespace {
+struct IntrinsicDesc {
+	const char* name;
+	IntrinsicType inputs[2];
+	IntrinsicType output;
+};
+
+const IntrinsicDesc intrinsicTable[] = {
+#define INTRINSIC(id, name, input1, input2, output) { name, { input1, input2 }, output },
+#include "intrinsics.def"
+#undef INTRINSIC
+};
+
+Ref<Type> intrinsicType(IntrinsicType type, size_t regSize)
+{
+	switch (type) {
+	case Int32:
+		return Type::IntegerType(4, false);
+	case Int64:
+		return Type::IntegerType(8, false);
+	case IntXlen:
+		return Type::IntegerType(regSize, false);
+	case Float32:
+		return Type::FloatType(4);
+	case Float64:
+		return Type::FloatType(8);
+	default:
+		return Type::VoidType();
+	}
+}
+}
+
+template <unsigned Xlen, BNEndianness Endian>
+std::string riscvArch<Xlen, Endian>::GetIntrinsicName(uint32_t intrinsic)
+{
+	if (intrinsic >= INTRINSIC_COUNT)
+		return "";
+	return intrinsicTable[intrinsic].name;
+}
+
+template <unsigned Xlen, BNEndianness Endian>
+std::vector<uint32_t> riscvArch<Xlen, Endian>::GetAllIntrinsics()
+{
+	std::vector<uint32_t> result(INTRINSIC_COUNT);
+	for (uint32_t i = 0; i < INTRINSIC_COUNT; i++)
+		result[i] = i;
+	return result;
+}
+
+template <unsigned Xlen, BNEndianness Endian>
+std::vector<NameAndType> riscvArch<Xlen, Endian>::GetIntrinsicInputs(uint32_t intrinsic)
+{
+	std::vector<NameAndType> result;
+	if (intrinsic >= INTRINSIC_COUNT)
+		return result;
+	for (IntrinsicType type : intrinsicTable[intrinsic].inputs) {
+		if (type != IntrinsicNone)
+			result.emplace_back(intrinsicType(type, RegSize));
+	}
+	return result;
+}
+
+template <unsigned Xlen, BNEndianness Endian>
+std::vector<Confidence<Ref<Type>>> riscvArch<Xlen, Endian>::GetIntrinsicOutputs(uint32_t intrinsic)
+{
+	if (intrinsic >= INTRINSIC_COUNT || intrinsicTable[intrinsic].output == IntrinsicNone)
+		return {};
+	return { intrinsicType(intrinsicTable[intrinsic].output, RegSize) };
+}
+
+template class riscvArch<32, LittleEndian>;
+template class riscvArch<32, BigEndian>;
+template class riscvArch<64, LittleEndian>;
+template class riscvArch<64, BigEndian>;
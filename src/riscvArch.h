@@ -3,14 +3,16 @@
 
 #include <binaryninjaapi.h>
 
+// Xlen is 32 or 64 and fixes the register and address width. Instructions
+// are always little-endian, Endian is the byte order of data in memory.
+template <unsigned Xlen, BNEndianness Endian>
 class riscvArch : public BinaryNinja::Architecture {
-	size_t addressSize = 32;
-	BNEndianness endian;
+	static constexpr size_t RegSize = Xlen / 8;
 
-	static BNRegisterInfo RegisterInfo(uint32_t fullWidthReg);
+	static BNRegisterInfo RegisterInfo(uint32_t fullWidthReg, size_t size = RegSize);
 
 public:
-	riscvArch(const std::string& name, BNEndianness endian_);
+	explicit riscvArch(const std::string& name);
 
 	BNEndianness GetEndianness() const override;
 
@@ -20,6 +22,8 @@ public:
 
 	size_t GetMaxInstructionLength() const override;
 
+	size_t GetInstructionAlignment() const override;
+
 	std::string GetRegisterName(uint32_t reg) override;
 
 	bool GetInstructionInfo(const uint8_t* data, uint64_t addr, size_t maxLen,
@@ -43,6 +47,15 @@ public:
 	std::string GetRegisterStackName(uint32_t regStack) override;
 
 	uint32_t GetLinkRegister() override;
+
+	std::string GetIntrinsicName(uint32_t intrinsic) override;
+
+	std::vector<uint32_t> GetAllIntrinsics() override;
+
+	std::vector<BinaryNinja::NameAndType> GetIntrinsicInputs(uint32_t intrinsic) override;
+
+	std::vector<BinaryNinja::Confidence<BinaryNinja::Ref<BinaryNinja::Type>>> GetIntrinsicOutputs(
+		uint32_t intrinsic) override;
 };
 
 #endif // BN_RISCV_ARCH_RISCVARCH_H
@@ -5,14 +5,17 @@
 std::vector<uint32_t> riscvCallingConvention::GetCalleeSavedRegisters()
 {
 	std::vector<uint32_t> regs = { sp, s0, s1, s2, s3, s4, s5,
-		s6, s7, s8, s9, s10, s11 };
+		s6, s7, s8, s9, s10, s11, fs0, fs1, fs2, fs3, fs4, fs5, fs6,
+		fs7, fs8, fs9, fs10, fs11 };
 	return regs;
 }
 
 std::vector<uint32_t> riscvCallingConvention::GetCallerSavedRegisters()
 {
 	std::vector<uint32_t> regs = { ra, t0, t1, t2, a0, a1, a2, a3,
-		a4, a5, a6, a7, t3, t4, t5, t6 };
+		a4, a5, a6, a7, t3, t4, t5, t6, ft0, ft1, ft2, ft3, ft4, ft5,
+		ft6, ft7, fa0, fa1, fa2, fa3, fa4, fa5, fa6, fa7, ft8, ft9,
+		ft10, ft11 };
 	return regs;
 }
 
@@ -22,6 +25,12 @@ std::vector<uint32_t> riscvCallingConvention::GetIntegerArgumentRegisters()
 	return regs;
 }
 
+std::vector<uint32_t> riscvCallingConvention::GetFloatArgumentRegisters()
+{
+	std::vector<uint32_t> regs = { fa0, fa1, fa2, fa3, fa4, fa5, fa6, fa7 };
+	return regs;
+}
+
 bool riscvCallingConvention::AreArgumentRegistersUsedForVarArgs()
 {
 	return true;
@@ -34,4 +43,6 @@ bool riscvCallingConvention::IsStackReservedForArgumentRegisters()
 
 uint32_t riscvCallingConvention::GetIntegerReturnValueRegister() { return a0; }
 
+uint32_t riscvCallingConvention::GetFloatReturnValueRegister() { return fa0; }
+
 uint32_t riscvCallingConvention::GetGlobalPointerRegister() { return gp; }
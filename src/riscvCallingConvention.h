@@ -16,12 +16,16 @@ public:
 
 	std::vector<uint32_t> GetIntegerArgumentRegisters() override;
 
+	std::vector<uint32_t> GetFloatArgumentRegisters() override;
+
 	bool AreArgumentRegistersUsedForVarArgs() override;
 
 	bool IsStackReservedForArgumentRegisters() override;
 
 	uint32_t GetIntegerReturnValueRegister() override;
 
+	uint32_t GetFloatReturnValueRegister() override;
+
 	uint32_t GetGlobalPointerRegister() override;
 };
 
@@ -0,0 +1,124 @@
+#include "tracer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace {
+// Fields are atomics so save() can read a slot while its thread overwrites
+// it. Torn events are detected from the head and skipped.
+struct Event {
+	std::atomic<const char*> name { nullptr };
+	std::atomic<uint64_t> addr { 0 };
+	std::atomic<uint64_t> start { 0 };
+	std::atomic<uint64_t> duration { 0 };
+};
+
+struct ThreadBuffer {
+	uint32_t tid = 0;
+	// Number of events ever written, the next one goes to head % Capacity
+	std::atomic<uint64_t> head { 0 };
+	// Events before this index were cleared
+	std::atomic<uint64_t> tail { 0 };
+	Event events[Tracer::Capacity];
+};
+
+const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+
+std::mutex registryLock;
+// Kept after their thread exits so its events can still be saved
+std::vector<std::unique_ptr<ThreadBuffer>> registry;
+
+ThreadBuffer& threadBuffer()
+{
+	static thread_local ThreadBuffer* buffer = nullptr;
+	if (!buffer) {
+		std::lock_guard<std::mutex> guard(registryLock);
+		registry.push_back(std::make_unique<ThreadBuffer>());
+		buffer = registry.back().get();
+		buffer->tid = registry.size();
+	}
+	return *buffer;
+}
+}
+
+uint64_t Tracer::now()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count();
+}
+
+void Tracer::record(const char* name, uint64_t addr, uint64_t start, uint64_t end)
+{
+	ThreadBuffer& buffer = threadBuffer();
+	const uint64_t head = buffer.head.load(std::memory_order_relaxed);
+	Event& event = buffer.events[head % Capacity];
+	// Orders the previous head store before the slot stores, so a reader that
+	// sees any of them also sees the head that marks the slot as overwritten
+	std::atomic_thread_fence(std::memory_order_release);
+	event.name.store(name, std::memory_order_relaxed);
+	event.addr.store(addr, std::memory_order_relaxed);
+	event.start.store(start, std::memory_order_relaxed);
+	event.duration.store(end - start, std::memory_order_relaxed);
+	buffer.head.store(head + 1, std::memory_order_release);
+}
+
+int64_t Tracer::save(const std::string& path)
+{
+	FILE* file = fopen(path.c_str(), "w");
+	if (!file)
+		return -1;
+
+	std::lock_guard<std::mutex> guard(registryLock);
+	int64_t written = 0;
+	fprintf(file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+	for (const auto& buffer : registry) {
+		fprintf(file, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"worker %u\"}}",
+			buffer == registry.front() ? "" : ",", buffer->tid, buffer->tid);
+
+		const uint64_t head = buffer->head.load(std::memory_order_acquire);
+		uint64_t first = head > Capacity ? head - Capacity : 0;
+		first = std::max(first, buffer->tail.load(std::memory_order_relaxed));
+
+		struct Copy {
+			const char* name;
+			uint64_t addr, start, duration;
+		};
+		std::vector<Copy> copies;
+		copies.reserve(head - first);
+		for (uint64_t i = first; i < head; i++) {
+			const Event& event = buffer->events[i % Capacity];
+			copies.push_back({ event.name.load(std::memory_order_relaxed), event.addr.load(std::memory_order_relaxed),
+				event.start.load(std::memory_order_relaxed), event.duration.load(std::memory_order_relaxed) });
+		}
+
+		// The thread may have wrapped around onto the oldest slots while they
+		// were copied, including the one it is writing now. The fence keeps the
+		// copies from being read after the head, as in the decode cache.
+		std::atomic_thread_fence(std::memory_order_acquire);
+		const uint64_t after = buffer->head.load(std::memory_order_acquire);
+		const uint64_t valid = after >= Capacity ? after - Capacity + 1 : 0;
+		for (uint64_t i = std::max(first, valid); i < head; i++) {
+			const Copy& event = copies[i - first];
+			fprintf(file,
+				",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f,"
+				"\"args\":{\"addr\":\"0x%" PRIx64 "\"}}",
+				event.name, buffer->tid, event.start / 1000.0, event.duration / 1000.0, event.addr);
+			written++;
+		}
+	}
+	fprintf(file, "\n]}\n");
+	fclose(file);
+	return written;
+}
+
+void Tracer::clear()
+{
+	std::lock_guard<std::mutex> guard(registryLock);
+	for (const auto& buffer : registry)
+		buffer->tail.store(buffer->head.load(std::memory_order_acquire), std::memory_order_relaxed);
+}
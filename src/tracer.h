@@ -0,0 +1,56 @@
+#ifndef BN_RISCV_ARCH_TRACER_H
+#define BN_RISCV_ARCH_TRACER_H
+
+#include <cstdint>
+#include <string>
+
+// Opt-in timeline of the architecture callbacks, saved in the Chrome trace
+// event format that chrome://tracing and Perfetto open. Build with
+// BN_RISCV_TRACE to enable it, otherwise RISCV_TRACE_SCOPE expands to nothing.
+//
+// Each thread writes its events into its own ring buffer without locks. The
+// buffers keep the most recent Capacity events per thread.
+class Tracer {
+public:
+	static constexpr size_t Capacity = 1 << 15;
+
+	// Nanoseconds since tracing started
+	static uint64_t now();
+
+	// name must be a string literal, it is stored by pointer
+	static void record(const char* name, uint64_t addr, uint64_t start, uint64_t end);
+
+	// Writes the buffered events of every thread to path. Returns the number
+	// of events written, or -1 if the file could not be created.
+	static int64_t save(const std::string& path);
+
+	static void clear();
+};
+
+// Records a trace event covering the enclosing scope
+class TraceScope {
+	const char* name;
+	uint64_t addr;
+	uint64_t start;
+
+public:
+	TraceScope(const char* name_, uint64_t addr_)
+		: name(name_)
+		, addr(addr_)
+		, start(Tracer::now())
+	{
+	}
+
+	~TraceScope() { Tracer::record(name, addr, start, Tracer::now()); }
+
+	TraceScope(const TraceScope&) = delete;
+	TraceScope& operator=(const TraceScope&) = delete;
+};
+
+#ifdef BN_RISCV_TRACE
+#define RISCV_TRACE_SCOPE(name, addr) TraceScope traceScope(name, addr)
+#else
+#define RISCV_TRACE_SCOPE(name, addr)
+#endif
+
+#endif // BN_RISCV_ARCH_TRACER_H
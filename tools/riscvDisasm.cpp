@@ -0,0 +1,414 @@
+// Standalone linear disassembler
+//
+// Disassembles a raw image without loading it into Binary Ninja:
+//
+//   riscv_disasm [--base addr] [--xlen 32|64] [--format text|ndjson] [--threads n] [-o out] image
+//
+// The image is memory mapped and split into chunks that are decoded in
+// parallel, then written out in address order. Text output follows the
+// objdump layout, NDJSON output has one object per instruction with its
+// address, raw encoding, mnemonic and operands.
+//
+// A chunk boundary can fall in the middle of a 4-byte instruction, so each
+// chunk is swept from both its start and 2 bytes in until the two sweeps
+// meet. When the chunks are stitched together the sweep matching where the
+// previous chunk ended is used, which gives the same output as a single
+// sequential sweep. Past the meeting point there is a single sweep, which
+// decodes a block at a time with Disassembler::decodeRange().
+
+#include <algorithm>
+#include <atomic>
+#include <cinttypes>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "compressed.h"
+#include "disassembler.h"
+#include "fetch.h"
+#include "formatter.h"
+
+namespace {
+constexpr size_t ChunkSize = 256 * 1024;
+// Finished chunks buffered per worker thread before the writer catches up
+constexpr size_t ChunksPerThread = 2;
+// Instructions decoded at a time once the two sweeps of a chunk meet
+constexpr size_t BlockSize = 64;
+
+enum class Format {
+	Text,
+	Ndjson
+};
+
+struct Options {
+	std::string input;
+	std::string output;
+	uint64_t base = 0;
+	unsigned xlen = 64;
+	Format format = Format::Text;
+	unsigned threads = 0;
+};
+
+class MappedFile {
+public:
+	~MappedFile()
+	{
+#ifdef _WIN32
+		if (data)
+			UnmapViewOfFile(data);
+#else
+		if (data)
+			munmap((void*)data, length);
+#endif
+	}
+
+	bool open(const std::string& path)
+	{
+#ifdef _WIN32
+		HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+			FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE)
+			return false;
+		LARGE_INTEGER size;
+		bool ok = GetFileSizeEx(file, &size);
+		length = ok ? (size_t)size.QuadPart : 0;
+		if (ok && length != 0) {
+			HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+			data = mapping ? (const uint8_t*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+			ok = data != nullptr;
+			if (mapping)
+				CloseHandle(mapping);
+		}
+		CloseHandle(file);
+		return ok;
+#else
+		const int fd = ::open(path.c_str(), O_RDONLY);
+		if (fd < 0)
+			return false;
+		struct stat st;
+		bool ok = fstat(fd, &st) == 0;
+		length = ok ? (size_t)st.st_size : 0;
+		if (ok && length != 0) {
+			void* mapped = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+			ok = mapped != MAP_FAILED;
+			if (ok) {
+				data = (const uint8_t*)mapped;
+				madvise(mapped, length, MADV_SEQUENTIAL);
+			}
+		}
+		close(fd);
+		return ok;
+#endif
+	}
+
+	const uint8_t* data = nullptr;
+	size_t length = 0;
+};
+
+// Output of one chunk. Entry 0 is the chunk start and entry 1 is 2 bytes in.
+struct ChunkOutput {
+	// Instructions before the two sweeps meet
+	std::string prefix[2];
+	// Instructions from where the sweeps meet to the end of the chunk
+	std::string body;
+	// Where the sweep from each entry left the chunk
+	size_t exit[2];
+	bool ready = false;
+};
+
+template <unsigned Xlen>
+class Disassembly {
+	const uint8_t* data;
+	size_t length;
+	uint64_t base;
+	Format format;
+
+	// Decodes without going through Diagnostics, undecodable words are
+	// expected in raw images and are printed as data instead
+	static Instruction decode(const uint8_t* bytes, size_t size)
+	{
+		if (size == 2) {
+			const uint16_t parcel = Fetch::parcel(bytes);
+			const uint32_t expanded = Xlen == 32 ? Compressed::expand32(parcel) : Compressed::expand(parcel);
+			Instruction instr = expanded ? Disassembler::decode<Xlen>(expanded) : Instruction {};
+			instr.size = 2;
+			return instr;
+		}
+		return Disassembler::decode<Xlen>(Fetch::word(bytes));
+	}
+
+	void line(std::string& out, uint64_t addr, uint32_t raw, size_t size, const char* mnemonic,
+		size_t mnemonicLength, const std::string& operands) const
+	{
+		char buf[64];
+		if (format == Format::Text) {
+			snprintf(buf, sizeof(buf), "%8" PRIx64 ":\t%0*x%*s\t", addr, (int)size * 2, raw, 8 - (int)size * 2, "");
+			out += buf;
+			out.append(mnemonic, mnemonicLength);
+			if (!operands.empty()) {
+				out += '\t';
+				out += operands;
+			}
+			out += '\n';
+			return;
+		}
+
+		snprintf(buf, sizeof(buf), "{\"address\":\"0x%" PRIx64 "\",\"raw\":\"0x%0*x\",\"mnemonic\":\"", addr,
+			(int)size * 2, raw);
+		out += buf;
+		out.append(mnemonic, mnemonicLength);
+		out += "\",\"operands\":\"";
+		out += operands;
+		out += "\"}\n";
+	}
+
+	// Prints bytes that are not an instruction as a data directive
+	void directive(std::string& out, uint64_t addr, uint32_t raw, size_t size, std::string& operands) const
+	{
+		static const char* const names[] = { nullptr, ".byte", ".2byte", nullptr, ".4byte" };
+		char value[16];
+		snprintf(value, sizeof(value), "0x%0*x", (int)size * 2, raw);
+		operands = value;
+		line(out, addr, raw, size, names[size], strlen(names[size]), operands);
+	}
+
+	// Appends the instruction at offset and returns its length
+	size_t emit(std::string& out, size_t offset, TokenList& tokens, std::string& operands) const
+	{
+		const uint64_t addr = base + offset;
+		const size_t size = Fetch::length(data + offset, length - offset);
+		if (size == 0) {
+			// Trailing bytes too short for an instruction
+			directive(out, addr, data[offset], 1, operands);
+			return 1;
+		}
+
+		const Instruction instr = decode(data + offset, size);
+		if (instr.type == InstrType::Error) {
+			const uint32_t raw = size == 2 ? Fetch::parcel(data + offset) : Fetch::word(data + offset);
+			directive(out, addr, raw, size, operands);
+			return size;
+		}
+
+		print(out, offset, instr, tokens, operands);
+		return size;
+	}
+
+	// Appends instr, decoded at offset
+	void print(std::string& out, size_t offset, const Instruction& instr, TokenList& tokens,
+		std::string& operands) const
+	{
+		const uint64_t addr = base + offset;
+		const uint32_t raw = instr.size == 2 ? Fetch::parcel(data + offset) : Fetch::word(data + offset);
+		Formatter::render<Xlen>(instr, addr, tokens);
+		// The mnemonic is followed by alignment padding and a space
+		operands.clear();
+		for (size_t i = 3; i < tokens.size(); i++)
+			operands.append(tokens[i].text, tokens[i].length);
+		line(out, addr, raw, instr.size, tokens[0].text, tokens[0].length, operands);
+	}
+
+	// Appends the instructions from offset up to end, decoding them a block
+	// at a time, and returns where the last one ends
+	size_t body(std::string& out, size_t offset, size_t end, TokenList& tokens, std::string& operands) const
+	{
+		Instruction block[BlockSize];
+		while (offset < end) {
+			// The last instruction may run past end, so the block can hold
+			// instructions beyond it that are left for the next chunk
+			const size_t count = Disassembler::decodeRange<Xlen>(data + offset, length - offset, block, BlockSize);
+			for (size_t i = 0; i < count && offset < end; i++) {
+				print(out, offset, block[i], tokens, operands);
+				offset += block[i].size;
+			}
+
+			// A block cut short by anything but control flow ends before an
+			// undecodable or truncated instruction, which is printed as data
+			if (offset < end && count < BlockSize
+				&& (count == 0 || !Disassembler::isControlFlow(block[count - 1].mnemonic)))
+				offset += emit(out, offset, tokens, operands);
+		}
+		return offset;
+	}
+
+public:
+	Disassembly(const uint8_t* data_, size_t length_, uint64_t base_, Format format_)
+		: data(data_)
+		, length(length_)
+		, base(base_)
+		, format(format_)
+	{
+	}
+
+	void sweep(size_t start, size_t end, ChunkOutput& result) const
+	{
+		TokenList tokens;
+		std::string operands;
+		size_t pos[2] = { start, start + 2 };
+
+		// Step whichever sweep is behind until they land on the same instruction
+		while (pos[0] != pos[1]) {
+			const int entry = pos[0] < pos[1] ? 0 : 1;
+			if (pos[entry] >= end)
+				break;
+			pos[entry] += emit(result.prefix[entry], pos[entry], tokens, operands);
+		}
+
+		if (pos[0] == pos[1])
+			pos[0] = pos[1] = body(result.body, pos[0], end, tokens, operands);
+		result.exit[0] = pos[0];
+		result.exit[1] = pos[1];
+	}
+};
+
+template <unsigned Xlen>
+bool run(const MappedFile& image, const Options& options, FILE* out)
+{
+	const Disassembly<Xlen> disassembly(image.data, image.length, options.base, options.format);
+	const size_t chunkCount = (image.length + ChunkSize - 1) / ChunkSize;
+	const unsigned threadCount = options.threads ? options.threads : std::max(1u, std::thread::hardware_concurrency());
+	const size_t window = (size_t)threadCount * ChunksPerThread;
+
+	std::vector<ChunkOutput> slots(window);
+	std::mutex lock;
+	std::condition_variable changed;
+	std::atomic<size_t> next { 0 };
+	size_t written = 0;
+
+	auto worker = [&]() {
+		for (;;) {
+			const size_t chunk = next.fetch_add(1, std::memory_order_relaxed);
+			if (chunk >= chunkCount)
+				return;
+
+			// Wait for the writer to free the slot
+			{
+				std::unique_lock<std::mutex> guard(lock);
+				changed.wait(guard, [&]() { return chunk < written + window; });
+			}
+
+			ChunkOutput& slot = slots[chunk % window];
+			const size_t start = chunk * ChunkSize;
+			disassembly.sweep(start, std::min(start + ChunkSize, image.length), slot);
+
+			std::lock_guard<std::mutex> guard(lock);
+			slot.ready = true;
+			changed.notify_all();
+		}
+	};
+
+	std::vector<std::thread> threads;
+	for (unsigned i = 0; i < threadCount; i++)
+		threads.emplace_back(worker);
+
+	bool ok = true;
+	size_t entry = 0;
+	for (size_t chunk = 0; chunk < chunkCount; chunk++) {
+		ChunkOutput& slot = slots[chunk % window];
+		{
+			std::unique_lock<std::mutex> guard(lock);
+			changed.wait(guard, [&]() { return slot.ready; });
+		}
+
+		// The previous chunk ended either at this chunk's start or inside
+		// its first 2 bytes
+		const size_t which = entry == chunk * ChunkSize ? 0 : 1;
+		if (ok) {
+			const std::string& prefix = slot.prefix[which];
+			ok = fwrite(prefix.data(), 1, prefix.size(), out) == prefix.size()
+				&& fwrite(slot.body.data(), 1, slot.body.size(), out) == slot.body.size();
+		}
+		entry = slot.exit[which];
+
+		slot.prefix[0].clear();
+		slot.prefix[1].clear();
+		slot.body.clear();
+		std::lock_guard<std::mutex> guard(lock);
+		slot.ready = false;
+		written++;
+		changed.notify_all();
+	}
+
+	for (std::thread& thread : threads)
+		thread.join();
+	return ok;
+}
+
+void usage(const char* argv0)
+{
+	fprintf(stderr, "usage: %s [--base addr] [--xlen 32|64] [--format text|ndjson] [--threads n] [-o out] image\n",
+		argv0);
+}
+}
+
+int main(int argc, char** argv)
+{
+	Options options;
+	for (int i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "--base") && i + 1 < argc)
+			options.base = strtoull(argv[++i], nullptr, 0);
+		else if (!strcmp(argv[i], "--xlen") && i + 1 < argc)
+			options.xlen = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "--format") && i + 1 < argc) {
+			const char* format = argv[++i];
+			if (!strcmp(format, "text"))
+				options.format = Format::Text;
+			else if (!strcmp(format, "ndjson"))
+				options.format = Format::Ndjson;
+			else {
+				usage(argv[0]);
+				return 2;
+			}
+		} else if (!strcmp(argv[i], "--threads") && i + 1 < argc)
+			options.threads = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-o") && i + 1 < argc)
+			options.output = argv[++i];
+		else if (argv[i][0] != '-' && options.input.empty())
+			options.input = argv[i];
+		else {
+			usage(argv[0]);
+			return 2;
+		}
+	}
+	if (options.input.empty() || (options.xlen != 32 && options.xlen != 64)) {
+		usage(argv[0]);
+		return 2;
+	}
+
+	MappedFile image;
+	if (!image.open(options.input)) {
+		fprintf(stderr, "could not map %s\n", options.input.c_str());
+		return 1;
+	}
+
+	FILE* out = options.output.empty() ? stdout : fopen(options.output.c_str(), "wb");
+	if (!out) {
+		fprintf(stderr, "could not open %s\n", options.output.c_str());
+		return 1;
+	}
+
+	const bool ok = options.xlen == 32 ? run<32>(image, options, out) : run<64>(image, options, out);
+	if (out != stdout)
+		fclose(out);
+	else
+		fflush(out);
+	if (!ok) {
+		fprintf(stderr, "write failed\n");
+		return 1;
+	}
+	return 0;
+}